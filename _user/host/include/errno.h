@@ -0,0 +1,26 @@
+/*
+ * Phoenix-RTOS
+ *
+ * Host build support
+ *
+ * Host errno.h with the Phoenix-RTOS additions
+ *
+ * Copyright 2026 Phoenix Systems
+ *
+ * This file is part of Phoenix-RTOS.
+ *
+ * %LICENSE%
+ */
+
+#ifndef _HOST_ERRNO_H_
+#define _HOST_ERRNO_H_
+
+#include_next <errno.h>
+
+
+#ifndef EOK
+#define EOK 0
+#endif
+
+
+#endif
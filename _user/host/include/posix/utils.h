@@ -0,0 +1,25 @@
+/*
+ * Phoenix-RTOS
+ *
+ * Host build support
+ *
+ * Host stand-in for <posix/utils.h>
+ *
+ * Copyright 2026 Phoenix Systems
+ *
+ * This file is part of Phoenix-RTOS.
+ *
+ * %LICENSE%
+ */
+
+#ifndef _HOST_POSIX_UTILS_H_
+#define _HOST_POSIX_UTILS_H_
+
+#include <sys/msg.h>
+
+
+/* Registers the device name, lookup() finds it from other processes */
+extern int create_dev(oid_t *oid, const char *path);
+
+
+#endif
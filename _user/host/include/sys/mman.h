@@ -0,0 +1,46 @@
+/*
+ * Phoenix-RTOS
+ *
+ * Host build support
+ *
+ * Host stand-in for the Phoenix-RTOS extensions of <sys/mman.h>.
+ * MAP_CONTIGUOUS memory is backed by a POSIX shared memory object and
+ * va2pa() returns a handle of it, which other processes map with
+ * MAP_PHYSMEM like physical memory on the target.
+ *
+ * Copyright 2026 Phoenix Systems
+ *
+ * This file is part of Phoenix-RTOS.
+ *
+ * %LICENSE%
+ */
+
+#ifndef _HOST_SYS_MMAN_H_
+#define _HOST_SYS_MMAN_H_
+
+#include_next <sys/mman.h>
+#include <sys/msg.h>
+
+#ifndef _PAGE_SIZE
+#define _PAGE_SIZE 4096
+#endif
+
+#define MAP_PHYSMEM    0x10000000
+#define MAP_CONTIGUOUS 0x20000000
+#define MAP_UNCACHED   0
+
+
+extern void *host_mmap(void *vaddr, size_t size, int prot, int flags, int fd, off_t offs);
+
+
+extern int host_munmap(void *vaddr, size_t size);
+
+
+extern addr_t va2pa(void *va);
+
+
+#define mmap   host_mmap
+#define munmap host_munmap
+
+
+#endif
@@ -0,0 +1,113 @@
+/*
+ * Phoenix-RTOS
+ *
+ * Host build support
+ *
+ * Host stand-in for the message passing API. Covers the part of the
+ * Phoenix-RTOS <sys/msg.h> used by the server demo and its clients.
+ *
+ * Copyright 2026 Phoenix Systems
+ *
+ * This file is part of Phoenix-RTOS.
+ *
+ * %LICENSE%
+ */
+
+#ifndef _HOST_SYS_MSG_H_
+#define _HOST_SYS_MSG_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#ifndef EOK
+#define EOK 0
+#endif
+
+
+typedef uintptr_t addr_t;
+
+
+typedef struct {
+	uint32_t port;
+	id_t id;
+} oid_t;
+
+
+typedef int msg_rid_t;
+
+
+enum { mtOpen = 0, mtClose, mtRead, mtWrite, mtTruncate, mtDevCtl, mtCreate, mtDestroy, mtSetAttr, mtGetAttr,
+	mtGetAttrAll, mtLookup, mtLink, mtUnlink, mtReaddir, mtStat, mtCount, mtSync = 0xf50 };
+
+
+enum { atMode = 0, atUid, atGid, atSize, atBlocks, atIOBlock, atType, atPort, atPollStatus, atEventMask,
+	atCTime, atMTime, atATime, atLinks, atDev };
+
+
+typedef struct {
+	int type;
+	unsigned int pid;
+	unsigned int priority;
+	oid_t oid;
+
+	struct {
+		union {
+			struct {
+				int flags;
+			} openclose;
+
+			struct {
+				off_t offs;
+				size_t len;
+				unsigned int mode;
+			} io;
+
+			struct {
+				long long val;
+				int type;
+			} attr;
+
+			unsigned char raw[64];
+		};
+
+		size_t size;
+		const void *data;
+	} i;
+
+	struct {
+		int err;
+
+		union {
+			struct {
+				long long val;
+			} attr;
+
+			unsigned char raw[64];
+		};
+
+		size_t size;
+		void *data;
+	} o;
+} msg_t;
+
+
+extern int portCreate(uint32_t *port);
+
+
+extern void portDestroy(uint32_t port);
+
+
+extern int msgSend(uint32_t port, msg_t *m);
+
+
+extern int msgRecv(uint32_t port, msg_t *m, msg_rid_t *rid);
+
+
+extern int msgRespond(uint32_t port, msg_t *m, msg_rid_t rid);
+
+
+extern int lookup(const char *name, oid_t *file, oid_t *dev);
+
+
+#endif
@@ -0,0 +1,71 @@
+/*
+ * Phoenix-RTOS
+ *
+ * Host build support
+ *
+ * Host stand-in for the threads and synchronization API. Stacks passed
+ * to beginthread() are not used, threads run on pthread stacks.
+ *
+ * Copyright 2026 Phoenix Systems
+ *
+ * This file is part of Phoenix-RTOS.
+ *
+ * %LICENSE%
+ */
+
+#ifndef _HOST_SYS_THREADS_H_
+#define _HOST_SYS_THREADS_H_
+
+#include <time.h>
+
+
+typedef int handle_t;
+
+
+extern int beginthreadex(void (*start)(void *), unsigned int priority, void *stack, unsigned int stacksz, void *arg, handle_t *id);
+
+
+static inline int beginthread(void (*start)(void *), unsigned int priority, void *stack, unsigned int stacksz, void *arg)
+{
+	return beginthreadex(start, priority, stack, stacksz, arg, NULL);
+}
+
+
+extern __attribute__((noreturn)) void endthread(void);
+
+
+extern int threadJoin(int tid, time_t timeout);
+
+
+extern int priority(int priority);
+
+
+extern int mutexCreate(handle_t *h);
+
+
+extern int mutexLock(handle_t h);
+
+
+extern int mutexTry(handle_t h);
+
+
+extern int mutexUnlock(handle_t h);
+
+
+extern int condCreate(handle_t *h);
+
+
+/* Timeout in microseconds, 0 - no timeout */
+extern int condWait(handle_t h, handle_t m, time_t timeout);
+
+
+extern int condSignal(handle_t h);
+
+
+extern int condBroadcast(handle_t h);
+
+
+extern int resourceDestroy(handle_t h);
+
+
+#endif
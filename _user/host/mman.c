@@ -0,0 +1,162 @@
+/*
+ * Phoenix-RTOS
+ *
+ * Host build support
+ *
+ * Host stand-in for MAP_CONTIGUOUS, MAP_PHYSMEM and va2pa(). Contiguous
+ * memory is a POSIX shared memory object, its "physical address" encodes
+ * the owner pid and the region slot, the offset is kept in the low bits.
+ *
+ * Copyright 2026 Phoenix Systems
+ *
+ * This file is part of Phoenix-RTOS.
+ *
+ * %LICENSE%
+ */
+
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#undef mmap
+#undef munmap
+
+
+#define HOST_REGIONS      64
+#define HOST_PA_PID_SHIFT 40
+#define HOST_PA_IDX_SHIFT 32
+#define HOST_PA_OFFS_MASK 0xffffffffULL
+
+
+static struct {
+	pthread_mutex_t lock;
+	struct {
+		void *va;
+		size_t size;
+	} regions[HOST_REGIONS];
+} mman_common = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+
+static void mman_name(char *name, size_t size, unsigned long long pid, unsigned int idx)
+{
+	snprintf(name, size, "/phoenix-mem-%llu-%u", pid, idx);
+}
+
+
+static void *mman_contiguous(void *vaddr, size_t size, int prot, int flags)
+{
+	void *va = MAP_FAILED;
+	char name[48];
+	unsigned int i;
+	int fd;
+
+	pthread_mutex_lock(&mman_common.lock);
+	for (i = 0; i < HOST_REGIONS; ++i) {
+		if (mman_common.regions[i].va == NULL) {
+			break;
+		}
+	}
+
+	if (i == HOST_REGIONS) {
+		pthread_mutex_unlock(&mman_common.lock);
+		errno = ENOMEM;
+		return MAP_FAILED;
+	}
+
+	mman_name(name, sizeof(name), getpid(), i);
+	shm_unlink(name);
+	fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd >= 0) {
+		if (ftruncate(fd, size) == 0) {
+			va = mmap(vaddr, size, prot, MAP_SHARED | (flags & MAP_FIXED), fd, 0);
+		}
+		close(fd);
+	}
+
+	if (va == MAP_FAILED) {
+		shm_unlink(name);
+	}
+	else {
+		mman_common.regions[i].va = va;
+		mman_common.regions[i].size = size;
+	}
+	pthread_mutex_unlock(&mman_common.lock);
+
+	return va;
+}
+
+
+static void *mman_physmem(void *vaddr, size_t size, int prot, int flags, off_t pa)
+{
+	char name[48];
+	void *va;
+	int fd;
+
+	mman_name(name, sizeof(name), (unsigned long long)pa >> HOST_PA_PID_SHIFT, (unsigned int)(pa >> HOST_PA_IDX_SHIFT) & 0xff);
+	fd = shm_open(name, O_RDWR, 0);
+	if (fd < 0) {
+		return MAP_FAILED;
+	}
+
+	va = mmap(vaddr, size, prot, MAP_SHARED | (flags & MAP_FIXED), fd, (off_t)(pa & HOST_PA_OFFS_MASK));
+	close(fd);
+
+	return va;
+}
+
+
+void *host_mmap(void *vaddr, size_t size, int prot, int flags, int fd, off_t offs)
+{
+	if ((flags & MAP_CONTIGUOUS) != 0) {
+		return mman_contiguous(vaddr, size, prot, flags);
+	}
+
+	if ((flags & MAP_PHYSMEM) != 0) {
+		return mman_physmem(vaddr, size, prot, flags, offs);
+	}
+
+	return mmap(vaddr, size, prot, flags & ~(MAP_PHYSMEM | MAP_CONTIGUOUS | MAP_UNCACHED), fd, offs);
+}
+
+
+int host_munmap(void *vaddr, size_t size)
+{
+	char name[48];
+	unsigned int i;
+
+	pthread_mutex_lock(&mman_common.lock);
+	for (i = 0; i < HOST_REGIONS; ++i) {
+		if (mman_common.regions[i].va == vaddr) {
+			mman_name(name, sizeof(name), getpid(), i);
+			shm_unlink(name);
+			mman_common.regions[i].va = NULL;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&mman_common.lock);
+
+	return munmap(vaddr, size);
+}
+
+
+addr_t va2pa(void *va)
+{
+	addr_t pa = 0;
+	unsigned int i;
+
+	pthread_mutex_lock(&mman_common.lock);
+	for (i = 0; i < HOST_REGIONS; ++i) {
+		if ((mman_common.regions[i].va != NULL) && ((unsigned char *)va >= (unsigned char *)mman_common.regions[i].va) &&
+				((unsigned char *)va < (unsigned char *)mman_common.regions[i].va + mman_common.regions[i].size)) {
+			pa = ((addr_t)getpid() << HOST_PA_PID_SHIFT) | ((addr_t)i << HOST_PA_IDX_SHIFT) |
+				(addr_t)((unsigned char *)va - (unsigned char *)mman_common.regions[i].va);
+			break;
+		}
+	}
+	pthread_mutex_unlock(&mman_common.lock);
+
+	return pa;
+}
@@ -0,0 +1,460 @@
+/*
+ * Phoenix-RTOS
+ *
+ * Host build support
+ *
+ * Host stand-in for the message passing API. A port is a POSIX shared
+ * memory object holding a request queue and message slots, synchronized
+ * with process-shared pthread primitives. Message data is copied into
+ * the slot by the sender, the receiver works on it in place like on the
+ * buffers mapped by the kernel on the target. Device names registered
+ * with create_dev() are files in $PHOENIX_HOST_DEV (/tmp/phoenix-dev).
+ *
+ * Copyright 2026 Phoenix Systems
+ *
+ * This file is part of Phoenix-RTOS.
+ *
+ * %LICENSE%
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/msg.h>
+#include <posix/utils.h>
+
+#undef mmap
+#undef munmap
+
+
+#define HOST_SLOTS   32
+#define HOST_DATA    (1024 * 1024) /* Limit of i.size and o.size */
+#define HOST_PORTS   16            /* Ports used by a process */
+#define HOST_DEV_DIR "/tmp/phoenix-dev"
+#define HOST_PRIO    4 /* Sender priority, host threads have the default one */
+
+
+enum { slotFree = 0, slotBusy, slotQueued, slotRecv, slotDone };
+
+
+typedef struct {
+	int state;
+	pthread_cond_t cond; /* Response ready */
+	msg_t msg;
+	unsigned char idata[HOST_DATA];
+	unsigned char odata[HOST_DATA];
+} host_slot_t;
+
+
+typedef struct {
+	pthread_mutex_t lock;
+	pthread_cond_t recvCond; /* Request queued or port closed */
+	pthread_cond_t freeCond; /* Slot freed */
+	int closed;
+	unsigned int head, tail;
+	unsigned int queue[HOST_SLOTS];
+	host_slot_t slots[HOST_SLOTS];
+} host_port_t;
+
+
+static struct {
+	pthread_mutex_t lock;
+	unsigned int created;
+	struct {
+		uint32_t port;
+		host_port_t *p;
+	} ports[HOST_PORTS];
+} msg_common = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+
+static void msg_portName(char *name, size_t size, uint32_t port)
+{
+	snprintf(name, size, "/phoenix-port-%u", port);
+}
+
+
+static host_port_t *msg_portMap(uint32_t port, int create)
+{
+	host_port_t *p;
+	char name[32];
+	int fd;
+
+	msg_portName(name, sizeof(name), port);
+
+	if (create != 0) {
+		/* Remove a leftover of a dead process with the same pid */
+		shm_unlink(name);
+		fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+		if ((fd >= 0) && (ftruncate(fd, sizeof(host_port_t)) < 0)) {
+			close(fd);
+			shm_unlink(name);
+			fd = -1;
+		}
+	}
+	else {
+		fd = shm_open(name, O_RDWR, 0);
+	}
+
+	if (fd < 0) {
+		return NULL;
+	}
+
+	p = mmap(NULL, sizeof(host_port_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+
+	return (p == MAP_FAILED) ? NULL : p;
+}
+
+
+/* Returns the port mapped in this process, maps it on first use */
+static host_port_t *msg_portGet(uint32_t port)
+{
+	host_port_t *p = NULL;
+	unsigned int i;
+
+	pthread_mutex_lock(&msg_common.lock);
+	for (i = 0; i < HOST_PORTS; ++i) {
+		if ((msg_common.ports[i].p != NULL) && (msg_common.ports[i].port == port)) {
+			p = msg_common.ports[i].p;
+			break;
+		}
+	}
+
+	if (p == NULL) {
+		for (i = 0; i < HOST_PORTS; ++i) {
+			if (msg_common.ports[i].p == NULL) {
+				p = msg_portMap(port, 0);
+				msg_common.ports[i].port = port;
+				msg_common.ports[i].p = p;
+				break;
+			}
+		}
+	}
+	pthread_mutex_unlock(&msg_common.lock);
+
+	return p;
+}
+
+
+int portCreate(uint32_t *port)
+{
+	pthread_mutexattr_t mattr;
+	pthread_condattr_t cattr;
+	host_port_t *p;
+	unsigned int i;
+
+	pthread_mutex_lock(&msg_common.lock);
+	for (i = 0; i < HOST_PORTS; ++i) {
+		if (msg_common.ports[i].p == NULL) {
+			break;
+		}
+	}
+
+	if (i == HOST_PORTS) {
+		pthread_mutex_unlock(&msg_common.lock);
+		return -ENOMEM;
+	}
+
+	*port = ((uint32_t)getpid() << 4) | (msg_common.created++ & 0xf);
+	p = msg_portMap(*port, 1);
+	if (p == NULL) {
+		pthread_mutex_unlock(&msg_common.lock);
+		return -ENOMEM;
+	}
+
+	pthread_mutexattr_init(&mattr);
+	pthread_mutexattr_setpshared(&mattr, PTHREAD_PROCESS_SHARED);
+	pthread_mutex_init(&p->lock, &mattr);
+	pthread_mutexattr_destroy(&mattr);
+
+	pthread_condattr_init(&cattr);
+	pthread_condattr_setpshared(&cattr, PTHREAD_PROCESS_SHARED);
+	pthread_cond_init(&p->recvCond, &cattr);
+	pthread_cond_init(&p->freeCond, &cattr);
+	for (i = 0; i < HOST_SLOTS; ++i) {
+		pthread_cond_init(&p->slots[i].cond, &cattr);
+	}
+	pthread_condattr_destroy(&cattr);
+
+	for (i = 0; i < HOST_PORTS; ++i) {
+		if (msg_common.ports[i].p == NULL) {
+			msg_common.ports[i].port = *port;
+			msg_common.ports[i].p = p;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&msg_common.lock);
+
+	return 0;
+}
+
+
+void portDestroy(uint32_t port)
+{
+	host_port_t *p = msg_portGet(port);
+	char name[32];
+	unsigned int i;
+
+	if (p == NULL) {
+		return;
+	}
+
+	pthread_mutex_lock(&p->lock);
+	p->closed = 1;
+	pthread_cond_broadcast(&p->recvCond);
+	pthread_cond_broadcast(&p->freeCond);
+	for (i = 0; i < HOST_SLOTS; ++i) {
+		pthread_cond_broadcast(&p->slots[i].cond);
+	}
+	pthread_mutex_unlock(&p->lock);
+
+	msg_portName(name, sizeof(name), port);
+	shm_unlink(name);
+}
+
+
+int msgSend(uint32_t port, msg_t *m)
+{
+	host_port_t *p;
+	host_slot_t *slot;
+	unsigned int i;
+	size_t osize;
+	void *odata;
+	int err = 0;
+
+	if ((m->i.size > HOST_DATA) || (m->o.size > HOST_DATA)) {
+		return -EINVAL;
+	}
+
+	p = msg_portGet(port);
+	if (p == NULL) {
+		return -EINVAL;
+	}
+
+	pthread_mutex_lock(&p->lock);
+	for (;;) {
+		for (i = 0; i < HOST_SLOTS; ++i) {
+			if (p->slots[i].state == slotFree) {
+				break;
+			}
+		}
+
+		if ((i != HOST_SLOTS) || (p->closed != 0)) {
+			break;
+		}
+		pthread_cond_wait(&p->freeCond, &p->lock);
+	}
+
+	if (p->closed != 0) {
+		pthread_mutex_unlock(&p->lock);
+		return -EINVAL;
+	}
+
+	slot = &p->slots[i];
+	slot->state = slotBusy;
+	pthread_mutex_unlock(&p->lock);
+
+	slot->msg = *m;
+	slot->msg.pid = getpid();
+	slot->msg.priority = HOST_PRIO;
+	if (m->i.size != 0) {
+		memcpy(slot->idata, m->i.data, m->i.size);
+	}
+
+	pthread_mutex_lock(&p->lock);
+	slot->state = slotQueued;
+	p->queue[p->tail++ % HOST_SLOTS] = i;
+	pthread_cond_signal(&p->recvCond);
+
+	while ((slot->state != slotDone) && (p->closed == 0)) {
+		pthread_cond_wait(&slot->cond, &p->lock);
+	}
+	if (slot->state != slotDone) {
+		err = -EINVAL;
+	}
+	pthread_mutex_unlock(&p->lock);
+
+	if (err == 0) {
+		odata = m->o.data;
+		osize = m->o.size;
+		m->o = slot->msg.o;
+		m->o.data = odata;
+		m->o.size = osize;
+		if (osize != 0) {
+			memcpy(odata, slot->odata, osize);
+		}
+	}
+
+	pthread_mutex_lock(&p->lock);
+	slot->state = slotFree;
+	pthread_cond_signal(&p->freeCond);
+	pthread_mutex_unlock(&p->lock);
+
+	return err;
+}
+
+
+int msgRecv(uint32_t port, msg_t *m, msg_rid_t *rid)
+{
+	host_port_t *p = msg_portGet(port);
+	host_slot_t *slot;
+	unsigned int i;
+
+	if (p == NULL) {
+		return -EINVAL;
+	}
+
+	pthread_mutex_lock(&p->lock);
+	while ((p->head == p->tail) && (p->closed == 0)) {
+		pthread_cond_wait(&p->recvCond, &p->lock);
+	}
+
+	if (p->closed != 0) {
+		pthread_mutex_unlock(&p->lock);
+		return -EINVAL;
+	}
+
+	i = p->queue[p->head++ % HOST_SLOTS];
+	slot = &p->slots[i];
+	slot->state = slotRecv;
+	pthread_mutex_unlock(&p->lock);
+
+	*m = slot->msg;
+	m->i.data = (m->i.size != 0) ? slot->idata : NULL;
+	m->o.data = (m->o.size != 0) ? slot->odata : NULL;
+	*rid = (msg_rid_t)i;
+
+	return 0;
+}
+
+
+int msgRespond(uint32_t port, msg_t *m, msg_rid_t rid)
+{
+	host_port_t *p = msg_portGet(port);
+	host_slot_t *slot;
+
+	if ((p == NULL) || (rid < 0) || (rid >= HOST_SLOTS)) {
+		return -EINVAL;
+	}
+
+	slot = &p->slots[rid];
+	if (slot->state != slotRecv) {
+		return -EINVAL;
+	}
+
+	/* Output data was written to the slot in place */
+	slot->msg.o.err = m->o.err;
+	memcpy(slot->msg.o.raw, m->o.raw, sizeof(m->o.raw));
+
+	pthread_mutex_lock(&p->lock);
+	slot->state = slotDone;
+	pthread_cond_signal(&slot->cond);
+	pthread_mutex_unlock(&p->lock);
+
+	return 0;
+}
+
+
+static const char *msg_devDir(void)
+{
+	const char *dir = getenv("PHOENIX_HOST_DEV");
+
+	return (dir != NULL) ? dir : HOST_DEV_DIR;
+}
+
+
+/* Device file name in the registry directory, "/dev/x" and "x" are the same device */
+static int msg_devPath(char *path, size_t size, const char *name)
+{
+	if (strncmp(name, "/dev/", 5) == 0) {
+		name += 5;
+	}
+
+	if ((*name == '\0') || (strchr(name, '/') != NULL)) {
+		return -EINVAL;
+	}
+
+	if (snprintf(path, size, "%s/%s", msg_devDir(), name) >= (int)size) {
+		return -ENAMETOOLONG;
+	}
+
+	return 0;
+}
+
+
+int create_dev(oid_t *oid, const char *path)
+{
+	char name[256], tmp[272];
+	FILE *f;
+	int err;
+
+	err = msg_devPath(name, sizeof(name), path);
+	if (err < 0) {
+		return err;
+	}
+
+	if ((mkdir(msg_devDir(), 0777) < 0) && (errno != EEXIST)) {
+		return -errno;
+	}
+
+	/* Replace the entry atomically for concurrent lookups */
+	snprintf(tmp, sizeof(tmp), "%s.%d", name, getpid());
+	f = fopen(tmp, "w");
+	if (f == NULL) {
+		return -errno;
+	}
+	fprintf(f, "%u %llu\n", oid->port, (unsigned long long)oid->id);
+	fclose(f);
+
+	if (rename(tmp, name) < 0) {
+		err = -errno;
+		unlink(tmp);
+		return err;
+	}
+
+	return 0;
+}
+
+
+int lookup(const char *name, oid_t *file, oid_t *dev)
+{
+	char path[256];
+	unsigned long long id;
+	unsigned int port;
+	FILE *f;
+	int err;
+
+	err = msg_devPath(path, sizeof(path), name);
+	if (err < 0) {
+		return (err == -EINVAL) ? -ENOENT : err;
+	}
+
+	f = fopen(path, "r");
+	if (f == NULL) {
+		return -ENOENT;
+	}
+	err = fscanf(f, "%u %llu", &port, &id);
+	fclose(f);
+
+	if (err != 2) {
+		return -ENOENT;
+	}
+
+	if (file != NULL) {
+		file->port = port;
+		file->id = (id_t)id;
+	}
+
+	if (dev != NULL) {
+		dev->port = port;
+		dev->id = (id_t)id;
+	}
+
+	return 0;
+}
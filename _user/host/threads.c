@@ -0,0 +1,305 @@
+/*
+ * Phoenix-RTOS
+ *
+ * Host build support
+ *
+ * Host stand-in for the threads and synchronization API on pthreads
+ *
+ * Copyright 2026 Phoenix Systems
+ *
+ * This file is part of Phoenix-RTOS.
+ *
+ * %LICENSE%
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/threads.h>
+
+
+/* Handles are allocated in chunks on demand, resources never move */
+#define HOST_CHUNK   256
+#define HOST_CHUNKS  1024
+#define HOST_HANDLES (HOST_CHUNK * HOST_CHUNKS)
+
+
+enum { resFree = 0, resMutex, resCond, resThread };
+
+
+typedef struct {
+	int type;
+	union {
+		pthread_mutex_t mutex;
+		pthread_cond_t cond;
+		struct {
+			pthread_t id;
+			void (*start)(void *);
+			void *arg;
+		} thread;
+	};
+} host_res_t;
+
+
+static struct {
+	pthread_mutex_t lock;
+	host_res_t *chunks[HOST_CHUNKS];
+	unsigned int nchunks;
+} threads_common = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+
+static host_res_t *threads_res(handle_t h)
+{
+	return &threads_common.chunks[h / HOST_CHUNK][h % HOST_CHUNK];
+}
+
+
+/* Handle 0 is never used, Phoenix-RTOS code may treat it as invalid */
+static handle_t threads_alloc(int type)
+{
+	handle_t h;
+
+	pthread_mutex_lock(&threads_common.lock);
+	for (h = 1; h < (handle_t)(threads_common.nchunks * HOST_CHUNK); ++h) {
+		if (threads_res(h)->type == resFree) {
+			break;
+		}
+	}
+
+	if (h >= (handle_t)(threads_common.nchunks * HOST_CHUNK)) {
+		if (threads_common.nchunks == HOST_CHUNKS) {
+			pthread_mutex_unlock(&threads_common.lock);
+			fprintf(stderr, "host: out of handles, the limit is %d\n", HOST_HANDLES);
+			return -ENOMEM;
+		}
+
+		threads_common.chunks[threads_common.nchunks] = calloc(HOST_CHUNK, sizeof(host_res_t));
+		if (threads_common.chunks[threads_common.nchunks] == NULL) {
+			pthread_mutex_unlock(&threads_common.lock);
+			return -ENOMEM;
+		}
+		threads_common.nchunks++;
+	}
+
+	threads_res(h)->type = type;
+	pthread_mutex_unlock(&threads_common.lock);
+
+	return h;
+}
+
+
+static host_res_t *threads_get(handle_t h, int type)
+{
+	if ((h <= 0) || (h >= HOST_HANDLES) || (threads_common.chunks[h / HOST_CHUNK] == NULL) || (threads_res(h)->type != type)) {
+		return NULL;
+	}
+
+	return threads_res(h);
+}
+
+
+static void threads_free(handle_t h)
+{
+	pthread_mutex_lock(&threads_common.lock);
+	threads_res(h)->type = resFree;
+	pthread_mutex_unlock(&threads_common.lock);
+}
+
+
+static void *threads_start(void *arg)
+{
+	host_res_t *res = arg;
+
+	res->thread.start(res->thread.arg);
+
+	return NULL;
+}
+
+
+int beginthreadex(void (*start)(void *), unsigned int priority, void *stack, unsigned int stacksz, void *arg, handle_t *id)
+{
+	host_res_t *res;
+	handle_t h;
+
+	(void)priority;
+	(void)stack;
+	(void)stacksz;
+
+	h = threads_alloc(resThread);
+	if (h < 0) {
+		return h;
+	}
+
+	res = threads_res(h);
+	res->thread.start = start;
+	res->thread.arg = arg;
+
+	if (pthread_create(&res->thread.id, NULL, threads_start, res) != 0) {
+		threads_free(h);
+		return -ENOMEM;
+	}
+
+	if (id != NULL) {
+		*id = h;
+	}
+	else {
+		pthread_detach(res->thread.id);
+	}
+
+	return 0;
+}
+
+
+void endthread(void)
+{
+	pthread_exit(NULL);
+}
+
+
+int threadJoin(int tid, time_t timeout)
+{
+	host_res_t *res = threads_get(tid, resThread);
+
+	(void)timeout;
+
+	if (res == NULL) {
+		return -EINVAL;
+	}
+
+	pthread_join(res->thread.id, NULL);
+	threads_free(tid);
+
+	return tid;
+}
+
+
+int priority(int priority)
+{
+	/* Host threads run with the default policy */
+	(void)priority;
+
+	return 0;
+}
+
+
+int mutexCreate(handle_t *h)
+{
+	handle_t m = threads_alloc(resMutex);
+
+	if (m < 0) {
+		return m;
+	}
+
+	pthread_mutex_init(&threads_res(m)->mutex, NULL);
+	*h = m;
+
+	return 0;
+}
+
+
+int mutexLock(handle_t h)
+{
+	host_res_t *res = threads_get(h, resMutex);
+
+	return (res != NULL) ? -pthread_mutex_lock(&res->mutex) : -EINVAL;
+}
+
+
+int mutexTry(handle_t h)
+{
+	host_res_t *res = threads_get(h, resMutex);
+
+	return (res != NULL) ? -pthread_mutex_trylock(&res->mutex) : -EINVAL;
+}
+
+
+int mutexUnlock(handle_t h)
+{
+	host_res_t *res = threads_get(h, resMutex);
+
+	return (res != NULL) ? -pthread_mutex_unlock(&res->mutex) : -EINVAL;
+}
+
+
+int condCreate(handle_t *h)
+{
+	pthread_condattr_t attr;
+	handle_t c = threads_alloc(resCond);
+
+	if (c < 0) {
+		return c;
+	}
+
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&threads_res(c)->cond, &attr);
+	pthread_condattr_destroy(&attr);
+	*h = c;
+
+	return 0;
+}
+
+
+int condWait(handle_t h, handle_t m, time_t timeout)
+{
+	host_res_t *cond = threads_get(h, resCond), *mutex = threads_get(m, resMutex);
+	struct timespec ts;
+	int err;
+
+	if ((cond == NULL) || (mutex == NULL)) {
+		return -EINVAL;
+	}
+
+	if (timeout == 0) {
+		return -pthread_cond_wait(&cond->cond, &mutex->mutex);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	ts.tv_sec += timeout / 1000000;
+	ts.tv_nsec += (timeout % 1000000) * 1000;
+	if (ts.tv_nsec >= 1000000000) {
+		ts.tv_sec++;
+		ts.tv_nsec -= 1000000000;
+	}
+
+	err = pthread_cond_timedwait(&cond->cond, &mutex->mutex, &ts);
+
+	return (err == ETIMEDOUT) ? -ETIME : -err;
+}
+
+
+int condSignal(handle_t h)
+{
+	host_res_t *res = threads_get(h, resCond);
+
+	return (res != NULL) ? -pthread_cond_signal(&res->cond) : -EINVAL;
+}
+
+
+int condBroadcast(handle_t h)
+{
+	host_res_t *res = threads_get(h, resCond);
+
+	return (res != NULL) ? -pthread_cond_broadcast(&res->cond) : -EINVAL;
+}
+
+
+int resourceDestroy(handle_t h)
+{
+	host_res_t *mutex = threads_get(h, resMutex), *cond = threads_get(h, resCond);
+
+	if (mutex != NULL) {
+		pthread_mutex_destroy(&mutex->mutex);
+	}
+	else if (cond != NULL) {
+		pthread_cond_destroy(&cond->cond);
+	}
+	else {
+		return -EINVAL;
+	}
+
+	threads_free(h);
+
+	return 0;
+}
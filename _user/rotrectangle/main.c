@@ -33,6 +33,29 @@
 #include <sys/threads.h>
 
 
+/*
+ * Damaged regions tracked per frame, overlapping ones are merged. Instrumentation only:
+ * the demo draws through the adapter queues and never commits a frame, the list estimates
+ * what partial commits of the damaged regions would transfer compared to full frames.
+ */
+#define DAMAGE_MAX 4
+
+
+typedef struct {
+	int x0, y0; /* inclusive */
+	int x1, y1; /* exclusive */
+} damage_t;
+
+
+typedef struct {
+	damage_t rects[DAMAGE_MAX];
+	unsigned int n;
+	unsigned long long frames;
+	unsigned long long dirty; /* bytes a partial commit would transfer */
+	unsigned long long full;  /* bytes a full frame commit would transfer */
+} damagelist_t;
+
+
 typedef struct {
 	volatile unsigned int xc;
 	volatile unsigned int yc;
@@ -52,6 +75,7 @@ typedef struct {
 	unsigned int minxc;
 	unsigned int minyc;
 	char stop;
+	damagelist_t damage;
 } rotrectangle_t;
 
 
@@ -74,6 +98,74 @@ static void rotrectangle_switchmode(int canon)
 }
 
 
+static unsigned long long damage_area(const damage_t *r)
+{
+	return (unsigned long long)(r->x1 - r->x0) * (r->y1 - r->y0);
+}
+
+
+static void damage_merge(damage_t *dst, const damage_t *src)
+{
+	dst->x0 = src->x0 < dst->x0 ? src->x0 : dst->x0;
+	dst->y0 = src->y0 < dst->y0 ? src->y0 : dst->y0;
+	dst->x1 = src->x1 > dst->x1 ? src->x1 : dst->x1;
+	dst->y1 = src->y1 > dst->y1 ? src->y1 : dst->y1;
+}
+
+
+/* Adds region clipped to the screen, merging it with an overlapping one or the one growing least if the list is full */
+static void damage_add(damagelist_t *list, const graph_t *graphp, damage_t r)
+{
+	unsigned int i, best = 0;
+	unsigned long long growth, min = ~0ULL;
+	damage_t u;
+
+	r.x0 = r.x0 < 0 ? 0 : r.x0;
+	r.y0 = r.y0 < 0 ? 0 : r.y0;
+	r.x1 = r.x1 > (int)graphp->width ? (int)graphp->width : r.x1;
+	r.y1 = r.y1 > (int)graphp->height ? (int)graphp->height : r.y1;
+	if ((r.x0 >= r.x1) || (r.y0 >= r.y1))
+		return;
+
+	for (i = 0; i < list->n; i++) {
+		if ((r.x0 < list->rects[i].x1) && (list->rects[i].x0 < r.x1) && (r.y0 < list->rects[i].y1) && (list->rects[i].y0 < r.y1)) {
+			damage_merge(&list->rects[i], &r);
+			return;
+		}
+	}
+
+	if (list->n < DAMAGE_MAX) {
+		list->rects[list->n++] = r;
+		return;
+	}
+
+	for (i = 0; i < list->n; i++) {
+		u = list->rects[i];
+		damage_merge(&u, &r);
+		growth = damage_area(&u) - damage_area(&list->rects[i]);
+		if (growth < min) {
+			min = growth;
+			best = i;
+		}
+	}
+	damage_merge(&list->rects[best], &r);
+}
+
+
+/* Accounts a frame as if only the damaged regions were committed, nothing is transferred */
+static void damage_flush(damagelist_t *list, const graph_t *graphp)
+{
+	unsigned int i;
+
+	for (i = 0; i < list->n; i++)
+		list->dirty += damage_area(&list->rects[i]) * graphp->depth;
+
+	list->full += (unsigned long long)graphp->width * graphp->height * graphp->depth;
+	list->frames++;
+	list->n = 0;
+}
+
+
 static void rotrectangle_getkey(void *arg)
 {
 	char ch;
@@ -122,9 +214,9 @@ static void rotrectangle_getkey(void *arg)
 }
 
 
-static void rotrectangle_print(const rectangle_t *self, graph_t *graphp, unsigned int angle)
+static void rotrectangle_print(const rectangle_t *self, graph_t *graphp, unsigned int angle, damage_t *bbox)
 {
-	double dx, dy, alfa, xc, yc, a, b;
+	double dx, dy, alfa, xc, yc, a, b, r;
 	unsigned int x0, y0, x, y; /* (x,y) is start point for next rectangle lines */
 
 	xc = (double)self->xc;
@@ -159,6 +251,13 @@ static void rotrectangle_print(const rectangle_t *self, graph_t *graphp, unsigne
 	dx = a * cos(alfa);
 	dy = a * sin(alfa);
 	graph_line(graphp, x, y, (int)dx, (int)dy, 1, self->color, GRAPH_QUEUE_HIGH);
+
+	/* Rectangle fits in the circle around its center, one pixel margin for rounding and stroke */
+	r = sqrt(pow(a, 2.0) + pow(b, 2.0)) / 2.0;
+	bbox->x0 = (int)(xc - r) - 1;
+	bbox->y0 = (int)(yc - r) - 1;
+	bbox->x1 = (int)(xc + r) + 2;
+	bbox->y1 = (int)(yc + r) + 2;
 }
 
 
@@ -175,18 +274,23 @@ static void rotrectangle_save(rotrectangle_t *self)
 static void rotrectangle_rotating(rotrectangle_t *self, graph_t *graphp)
 {
 	unsigned int alfa;
+	damage_t bbox;
+
 	while (self->stop == 0) {
 		for (alfa = 0; alfa < 360; alfa += self->speed) {
 			if (self->stop != 0)
 				break;
 			mutexLock(self->lock);
-			rotrectangle_print(&(self->rec), graphp, alfa);
+			rotrectangle_print(&(self->rec), graphp, alfa, &bbox);
+			damage_add(&self->damage, graphp, bbox);
+			damage_flush(&self->damage, graphp);
 			/* filling rectangle functions are commented out, because of problem with screen refreshing, it's demo without it */
 			/* graph_fill(graphp, self->rec.xc, self->rec.yc, self->rec.color, GRAPH_FILL_FLOOD, GRAPH_QUEUE_HIGH); */
 			rotrectangle_save(self);
 			mutexUnlock(self->lock);
 			usleep(10000); /* min value */
-			rotrectangle_print(&(self->prev), graphp, alfa);
+			rotrectangle_print(&(self->prev), graphp, alfa, &bbox);
+			damage_add(&self->damage, graphp, bbox);
 			/* graph_fill(graphp, self->rec.xc, self->rec.yc, 0, GRAPH_FILL_FLOOD, GRAPH_QUEUE_HIGH); */
 		}
 	}
@@ -228,6 +332,7 @@ int main(void)
 	rotrectangle.rec.a = 180;
 	rotrectangle.rec.b = 90;
 	rotrectangle.rec.color = 60000;
+	rotrectangle.damage = (damagelist_t) { 0 };
 
 	rotrectangle_startpanel();
 
@@ -269,6 +374,12 @@ int main(void)
 
 	rotrectangle_switchmode(1);
 
+	if (rotrectangle.damage.full != 0) {
+		printf("rotrectangle: %llu frames, estimated commits: full %llu KiB, dirty regions %llu KiB (%llu.%llu%%)\n",
+			rotrectangle.damage.frames, rotrectangle.damage.full >> 10, rotrectangle.damage.dirty >> 10,
+			rotrectangle.damage.dirty * 100 / rotrectangle.damage.full, rotrectangle.damage.dirty * 1000 / rotrectangle.damage.full % 10);
+	}
+
 	graph_close(&graph);
 	graph_done();
 
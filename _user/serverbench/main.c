@@ -0,0 +1,779 @@
+/*
+ * Phoenix-RTOS
+ *
+ * Server benchmark
+ *
+ * Load generator for the server demo application. Measures round trip
+ * latency percentiles and request rate of msgSend()/msgRecv()/msgRespond()
+ * for a range of payload sizes and client thread counts, and the time
+ * it takes poll() to report the server FIFO readable after a write.
+ *
+ * Copyright 2026 Phoenix Systems
+ *
+ * This file is part of Phoenix-RTOS.
+ *
+ * %LICENSE%
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/threads.h>
+#include <sys/msg.h>
+
+#include "../serverdemo/serverdemo.h"
+
+
+#define BENCH_CLIENTS_MAX 32
+#define BENCH_STACKSZ     4096
+#define BENCH_LIST_MAX    16
+#define BENCH_POLL_PERIOD 2000 /* us between FIFO writes */
+#define BENCH_BACKOFF     1000 /* us before the next request after a reject */
+
+/* Latency histogram: 16 linear buckets per power of 2 (~6% resolution) */
+#define BENCH_HIST_SUBBITS 4
+#define BENCH_HIST_SUB     (1 << BENCH_HIST_SUBBITS)
+#define BENCH_HIST_SIZE    ((64 - BENCH_HIST_SUBBITS + 1) * BENCH_HIST_SUB)
+
+
+/* Transfer methods */
+enum { benchMsg = 0, benchPosix, benchShm, benchPoll, benchVec };
+
+
+typedef struct {
+	handle_t tid;
+	char *stack;
+	void *buf;
+	int fd;              /* benchPosix */
+	unsigned int region; /* benchShm */
+	size_t shmSize;
+	off_t offs;
+	unsigned int seed;
+	unsigned long long ops;
+	unsigned long long rejects;
+	unsigned long long lmax;
+	unsigned int hist[BENCH_HIST_SIZE];
+	int err;
+} bench_client_t;
+
+
+typedef struct {
+	size_t size;
+	unsigned int nclients;
+	unsigned int nsegs; /* Segments per request */
+	unsigned long long ops;
+	unsigned long long rejects; /* -EAGAIN responses, not in ops and latencies */
+	unsigned long long elapsed; /* ns */
+	unsigned long long p50, p99, p999, lmax; /* ns */
+} bench_result_t;
+
+
+static struct {
+	oid_t oid;
+	int type;
+	int method;
+	size_t size;
+	unsigned int nsegs; /* benchVec */
+	int random;
+	off_t range; /* Offsets are in [0, range), 0 - always at offset 0 */
+	volatile int stop;
+	bench_client_t clients[BENCH_CLIENTS_MAX];
+} bench_common;
+
+
+static unsigned long long bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+static unsigned int bench_histIdx(unsigned long long v)
+{
+	unsigned int msb;
+
+	if (v < BENCH_HIST_SUB) {
+		return (unsigned int)v;
+	}
+
+	msb = 63 - __builtin_clzll(v);
+
+	return (msb - BENCH_HIST_SUBBITS + 1) * BENCH_HIST_SUB + (unsigned int)((v >> (msb - BENCH_HIST_SUBBITS)) & (BENCH_HIST_SUB - 1));
+}
+
+
+/* Returns the lower bound of the bucket */
+static unsigned long long bench_histValue(unsigned int idx)
+{
+	unsigned int exp = idx / BENCH_HIST_SUB;
+
+	if (exp == 0) {
+		return idx;
+	}
+
+	return (unsigned long long)(BENCH_HIST_SUB + idx % BENCH_HIST_SUB) << (exp - 1);
+}
+
+
+static unsigned long long bench_histPercentile(const unsigned int *hist, unsigned long long total, unsigned int permille)
+{
+	unsigned long long rank = (total * permille + 999) / 1000, n = 0;
+	unsigned int i;
+
+	for (i = 0; i < BENCH_HIST_SIZE; ++i) {
+		n += hist[i];
+		if ((n >= rank) && (n != 0)) {
+			return bench_histValue(i);
+		}
+	}
+
+	return 0;
+}
+
+
+static off_t bench_nextOffs(bench_client_t *client)
+{
+	off_t offs = client->offs;
+
+	if (bench_common.range < (off_t)bench_common.size) {
+		return 0;
+	}
+
+	if (bench_common.random != 0) {
+		client->seed = client->seed * 1103515245 + 12345;
+		offs = ((off_t)(client->seed >> 4) % (bench_common.range / bench_common.size)) * bench_common.size;
+	}
+	else {
+		client->offs += bench_common.size;
+		if (client->offs + (off_t)bench_common.size > bench_common.range) {
+			client->offs = 0;
+		}
+	}
+
+	return offs;
+}
+
+
+static int bench_request(bench_client_t *client, off_t offs)
+{
+	serverdemo_devctl_t *devctl;
+	serverdemo_seg_t *segs;
+	unsigned int i;
+	msg_t msg;
+	ssize_t ret;
+	int err;
+
+	if (bench_common.method == benchPosix) {
+		if (bench_common.type == mtWrite) {
+			ret = pwrite(client->fd, client->buf, bench_common.size, offs);
+		}
+		else {
+			ret = pread(client->fd, client->buf, bench_common.size, offs);
+		}
+		return (ret < 0) ? -errno : 0;
+	}
+
+	memset(&msg, 0, sizeof(msg));
+	msg.oid = bench_common.oid;
+
+	if (bench_common.method == benchVec) {
+		/* The segment list is followed by the data of all segments */
+		segs = client->buf;
+		segs[0].offs = offs;
+		segs[0].len = bench_common.size;
+		for (i = 1; i < bench_common.nsegs; ++i) {
+			segs[i].offs = bench_nextOffs(client);
+			segs[i].len = bench_common.size;
+		}
+
+		devctl = (serverdemo_devctl_t *)msg.i.raw;
+		msg.type = mtDevCtl;
+		devctl->type = (bench_common.type == mtWrite) ? serverdemo_writev : serverdemo_readv;
+		devctl->vec.nsegs = bench_common.nsegs;
+
+		msg.i.data = segs;
+		msg.i.size = bench_common.nsegs * sizeof(*segs);
+		if (bench_common.type == mtWrite) {
+			msg.i.size += bench_common.nsegs * bench_common.size;
+		}
+		else {
+			msg.o.data = segs + bench_common.nsegs;
+			msg.o.size = bench_common.nsegs * bench_common.size;
+		}
+	}
+	else if (bench_common.method == benchShm) {
+		/* Only the descriptor is sent, data stays in the shared region */
+		devctl = (serverdemo_devctl_t *)msg.i.raw;
+		msg.type = mtDevCtl;
+		devctl->type = (bench_common.type == mtWrite) ? serverdemo_shmWrite : serverdemo_shmRead;
+		devctl->region = client->region;
+		devctl->io.offs = offs;
+		devctl->io.shmOffs = 0;
+		devctl->io.len = bench_common.size;
+	}
+	else {
+		msg.type = bench_common.type;
+		msg.i.io.offs = offs;
+		msg.i.io.len = bench_common.size;
+
+		if (bench_common.type == mtWrite) {
+			msg.i.data = client->buf;
+			msg.i.size = bench_common.size;
+		}
+		else {
+			msg.o.data = client->buf;
+			msg.o.size = bench_common.size;
+		}
+	}
+
+	err = msgSend(bench_common.oid.port, &msg);
+
+	return (err < 0) ? err : msg.o.err;
+}
+
+
+static void bench_client(void *arg)
+{
+	bench_client_t *client = arg;
+	unsigned long long start, lat;
+	off_t offs;
+	int err;
+
+	while (bench_common.stop == 0) {
+		offs = bench_nextOffs(client);
+
+		start = bench_now();
+		err = bench_request(client, offs);
+		lat = bench_now() - start;
+
+		if (err == -EAGAIN) {
+			/* Shed by the server under overload, back off like a real client would */
+			client->rejects++;
+			usleep(BENCH_BACKOFF);
+			continue;
+		}
+
+		if (err < 0) {
+			client->err = err;
+			break;
+		}
+
+		client->hist[bench_histIdx(lat)]++;
+		if (lat > client->lmax) {
+			client->lmax = lat;
+		}
+		client->ops++;
+	}
+
+	endthread();
+}
+
+
+/* Sets up the client buffer for the transfer method */
+static int bench_clientInit(bench_client_t *client, const char *path)
+{
+	serverdemo_devctl_t *devctl;
+	serverdemo_devctlo_t *devctlo;
+	msg_t msg;
+	int err;
+
+	client->fd = -1;
+
+	if (bench_common.method == benchPosix) {
+		client->fd = open(path, O_RDWR);
+		if (client->fd < 0) {
+			return -errno;
+		}
+	}
+
+	if (bench_common.method == benchVec) {
+		client->buf = malloc(bench_common.nsegs * (sizeof(serverdemo_seg_t) + bench_common.size));
+		return (client->buf == NULL) ? -ENOMEM : 0;
+	}
+
+	if (bench_common.method != benchShm) {
+		client->buf = malloc((bench_common.size != 0) ? bench_common.size : 1);
+		return (client->buf == NULL) ? -ENOMEM : 0;
+	}
+
+	memset(&msg, 0, sizeof(msg));
+	msg.type = mtDevCtl;
+	msg.oid = bench_common.oid;
+	devctl = (serverdemo_devctl_t *)msg.i.raw;
+	devctl->type = serverdemo_shmMap;
+	devctl->map.size = (bench_common.size != 0) ? bench_common.size : 1;
+
+	err = msgSend(bench_common.oid.port, &msg);
+	if ((err < 0) || (msg.o.err < 0)) {
+		return (err < 0) ? err : msg.o.err;
+	}
+
+	devctlo = (serverdemo_devctlo_t *)msg.o.raw;
+	client->region = devctlo->region;
+	client->shmSize = devctlo->size;
+	client->buf = mmap(NULL, devctlo->size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS | MAP_PHYSMEM, -1, devctlo->paddr);
+	if (client->buf == MAP_FAILED) {
+		client->buf = NULL;
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+
+static void bench_clientDone(bench_client_t *client)
+{
+	serverdemo_devctl_t *devctl;
+	msg_t msg;
+
+	if (client->fd >= 0) {
+		close(client->fd);
+	}
+
+	if (bench_common.method != benchShm) {
+		free(client->buf);
+		return;
+	}
+
+	if (client->buf != NULL) {
+		munmap(client->buf, client->shmSize);
+
+		memset(&msg, 0, sizeof(msg));
+		msg.type = mtDevCtl;
+		msg.oid = bench_common.oid;
+		devctl = (serverdemo_devctl_t *)msg.i.raw;
+		devctl->type = serverdemo_shmUnmap;
+		devctl->region = client->region;
+		msgSend(bench_common.oid.port, &msg);
+	}
+}
+
+
+static int bench_run(unsigned int nclients, unsigned int seconds, const char *path, bench_result_t *res)
+{
+	static unsigned int hist[BENCH_HIST_SIZE];
+	unsigned long long start;
+	unsigned int i, j, started;
+	int err = 0;
+
+	memset(hist, 0, sizeof(hist));
+	memset(res, 0, sizeof(*res));
+	res->size = bench_common.size;
+	res->nclients = nclients;
+	res->nsegs = (bench_common.method == benchVec) ? bench_common.nsegs : 1;
+
+	for (i = 0; i < nclients; ++i) {
+		bench_client_t *client = &bench_common.clients[i];
+
+		memset(client, 0, sizeof(*client));
+		client->fd = -1;
+		client->seed = i + 1;
+		client->stack = malloc(BENCH_STACKSZ);
+		if (client->stack == NULL) {
+			err = -ENOMEM;
+			break;
+		}
+
+		err = bench_clientInit(client, path);
+		if (err < 0) {
+			break;
+		}
+		memset(client->buf, 0x5a, bench_common.size);
+	}
+
+	if (err < 0) {
+		for (j = 0; j <= i && j < nclients; ++j) {
+			bench_clientDone(&bench_common.clients[j]);
+			free(bench_common.clients[j].stack);
+		}
+		return err;
+	}
+
+	bench_common.stop = 0;
+	start = bench_now();
+
+	for (started = 0; started < nclients; ++started) {
+		bench_client_t *client = &bench_common.clients[started];
+
+		if (beginthreadex(bench_client, 4, client->stack, BENCH_STACKSZ, client, &client->tid) < 0) {
+			err = -ENOMEM;
+			break;
+		}
+	}
+
+	if (err == 0) {
+		sleep(seconds);
+	}
+	bench_common.stop = 1;
+
+	for (i = 0; i < started; ++i) {
+		threadJoin(bench_common.clients[i].tid, 0);
+	}
+
+	res->elapsed = bench_now() - start;
+
+	for (i = 0; i < nclients; ++i) {
+		bench_client_t *client = &bench_common.clients[i];
+
+		res->ops += client->ops;
+		res->rejects += client->rejects;
+		if (client->lmax > res->lmax) {
+			res->lmax = client->lmax;
+		}
+		for (j = 0; j < BENCH_HIST_SIZE; ++j) {
+			hist[j] += client->hist[j];
+		}
+		if (client->err < 0) {
+			err = client->err;
+		}
+
+		bench_clientDone(client);
+		free(client->stack);
+	}
+
+	res->p50 = bench_histPercentile(hist, res->ops, 500);
+	res->p99 = bench_histPercentile(hist, res->ops, 990);
+	res->p999 = bench_histPercentile(hist, res->ops, 999);
+
+	return err;
+}
+
+
+/* Writes timestamps to the FIFO for bench_poll() */
+static void bench_pollWriter(void *arg)
+{
+	bench_client_t *client = arg;
+	unsigned long long now;
+
+	while (bench_common.stop == 0) {
+		usleep(BENCH_POLL_PERIOD);
+
+		now = bench_now();
+		if (write(client->fd, &now, sizeof(now)) < 0) {
+			if (errno == EAGAIN) {
+				continue;
+			}
+			client->err = -errno;
+			break;
+		}
+	}
+
+	endthread();
+}
+
+
+/* Measures the time from a FIFO write to poll() reporting it readable */
+static int bench_poll(unsigned int seconds, const char *path, bench_result_t *res)
+{
+	bench_client_t *poller = &bench_common.clients[0], *writer = &bench_common.clients[1];
+	unsigned long long start, deadline, now, stamp, lat;
+	struct pollfd pfd;
+	int err = 0, ret;
+
+	memset(res, 0, sizeof(*res));
+	memset(poller, 0, sizeof(*poller));
+	memset(writer, 0, sizeof(*writer));
+	res->size = sizeof(stamp);
+	res->nclients = 1;
+
+	poller->fd = open(path, O_RDONLY | O_NONBLOCK);
+	writer->fd = open(path, O_WRONLY | O_NONBLOCK);
+	writer->stack = malloc(BENCH_STACKSZ);
+	if ((poller->fd < 0) || (writer->fd < 0) || (writer->stack == NULL)) {
+		err = (writer->stack == NULL) ? -ENOMEM : -errno;
+	}
+
+	/* Drop leftovers of other FIFO users */
+	while ((err == 0) && (read(poller->fd, &stamp, sizeof(stamp)) > 0)) {
+	}
+
+	bench_common.stop = 0;
+	start = bench_now();
+	deadline = start + seconds * 1000000000ULL;
+
+	if ((err == 0) && (beginthreadex(bench_pollWriter, 4, writer->stack, BENCH_STACKSZ, writer, &writer->tid) < 0)) {
+		err = -ENOMEM;
+	}
+
+	while ((err == 0) && (bench_now() < deadline)) {
+		pfd.fd = poller->fd;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+
+		ret = poll(&pfd, 1, 100);
+		now = bench_now();
+		if (ret < 0) {
+			err = -errno;
+			break;
+		}
+		if ((ret == 0) || ((pfd.revents & POLLIN) == 0)) {
+			continue;
+		}
+
+		/* Only the oldest stamp gives the wakeup latency */
+		if (read(poller->fd, &stamp, sizeof(stamp)) != sizeof(stamp)) {
+			continue;
+		}
+		lat = (now > stamp) ? now - stamp : 0;
+		while (read(poller->fd, &stamp, sizeof(stamp)) > 0) {
+		}
+
+		poller->hist[bench_histIdx(lat)]++;
+		if (lat > res->lmax) {
+			res->lmax = lat;
+		}
+		res->ops++;
+	}
+
+	bench_common.stop = 1;
+	if (writer->tid != 0) {
+		threadJoin(writer->tid, 0);
+	}
+	res->elapsed = bench_now() - start;
+
+	if ((err == 0) && (writer->err < 0)) {
+		err = writer->err;
+	}
+
+	if (poller->fd >= 0) {
+		close(poller->fd);
+	}
+	if (writer->fd >= 0) {
+		close(writer->fd);
+	}
+	free(writer->stack);
+
+	res->p50 = bench_histPercentile(poller->hist, res->ops, 500);
+	res->p99 = bench_histPercentile(poller->hist, res->ops, 990);
+	res->p999 = bench_histPercentile(poller->hist, res->ops, 999);
+
+	return err;
+}
+
+
+static void bench_print(const bench_result_t *res, int csv)
+{
+	static const char *const methods[] = { "msg", "posix", "shm", "poll", "vec" };
+	const char *method = methods[bench_common.method];
+	const char *op = (bench_common.method == benchPoll) ? "wakeup" : ((bench_common.type == mtWrite) ? "write" : "read");
+	const char *pattern = (bench_common.random != 0) ? "rand" : "seq";
+	unsigned long long rate = 0, kibps = 0;
+
+	if (res->elapsed != 0) {
+		rate = res->ops * 1000000000ULL / res->elapsed;
+		kibps = rate * res->size * res->nsegs / 1024;
+	}
+
+	if (csv != 0) {
+		printf("%s,%s,%s,%zu,%u,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%u\n", method, op, pattern,
+			res->size, res->nclients, res->ops, res->elapsed / 1000, rate, kibps,
+			res->p50, res->p99, res->p999, res->lmax, res->rejects, res->nsegs);
+	}
+	else {
+		printf("serverbench: %s %s %s size=%zu segs=%u clients=%u requests=%llu rate=%llu req/s throughput=%llu KiB/s "
+			   "latency p50=%llu.%01llu p99=%llu.%01llu p999=%llu.%01llu max=%llu.%01llu us",
+			method, op, pattern, res->size, res->nsegs, res->nclients, res->ops, rate, kibps,
+			res->p50 / 1000, (res->p50 % 1000) / 100, res->p99 / 1000, (res->p99 % 1000) / 100,
+			res->p999 / 1000, (res->p999 % 1000) / 100, res->lmax / 1000, (res->lmax % 1000) / 100);
+		if (res->rejects != 0) {
+			printf(" rejected=%llu", res->rejects);
+		}
+		printf("\n");
+	}
+}
+
+
+/* Parses comma separated list of numbers */
+static int bench_parseList(const char *str, unsigned long *list, unsigned long min, unsigned long max)
+{
+	char *end;
+	int n = 0;
+
+	do {
+		if (n == BENCH_LIST_MAX) {
+			return -1;
+		}
+
+		list[n] = strtoul(str, &end, 0);
+		if ((end == str) || (list[n] < min) || (list[n] > max) || ((*end != ',') && (*end != '\0'))) {
+			return -1;
+		}
+		n++;
+		str = end + 1;
+	} while (*end == ',');
+
+	return n;
+}
+
+
+static void bench_usage(const char *progname)
+{
+	printf("Usage: %s [options]\n", progname);
+	printf("Options:\n");
+	printf("\t-p <path>     server special file (default /dev/serverdemo)\n");
+	printf("\t-o <op>       operation: read or write (default read)\n");
+	printf("\t-s <sizes>    comma separated payload sizes in bytes (default 16)\n");
+	printf("\t-r <range>    access offsets in [0, range) (default 0 - always at offset 0)\n");
+	printf("\t-a <pattern>  access pattern within range: seq or rand (default seq)\n");
+	printf("\t-x            use POSIX open()/pread()/pwrite() instead of messages\n");
+	printf("\t-z            transfer data through memory shared with the server\n");
+	printf("\t-V <segs>     send segs segments of size bytes in one vectored request\n");
+	printf("\t-W            measure poll() wakeup latency on a FIFO (default /dev/serverdemo-fifo)\n");
+	printf("\t-c <clients>  comma separated numbers of client threads (1-%u, default 1)\n", BENCH_CLIENTS_MAX);
+	printf("\t-t <seconds>  duration of each test (default 5)\n");
+	printf("\t-C            print results as CSV, latencies in ns\n");
+	printf("\t-h            print this help message\n");
+}
+
+
+int main(int argc, char **argv)
+{
+	const char *path = NULL;
+	unsigned long sizes[BENCH_LIST_MAX] = { 16 }, clients[BENCH_LIST_MAX] = { 1 };
+	unsigned int seconds = 5;
+	int nsizes = 1, nclients = 1, csv = 0, c, i, j, err;
+	bench_result_t res;
+
+	bench_common.type = mtRead;
+
+	while ((c = getopt(argc, argv, "p:o:s:r:a:xzV:Wc:t:Ch")) != -1) {
+		switch (c) {
+			case 'p':
+				path = optarg;
+				break;
+
+			case 'o':
+				if (strcmp(optarg, "read") == 0) {
+					bench_common.type = mtRead;
+				}
+				else if (strcmp(optarg, "write") == 0) {
+					bench_common.type = mtWrite;
+				}
+				else {
+					fprintf(stderr, "serverbench: invalid operation %s\n", optarg);
+					return EXIT_FAILURE;
+				}
+				break;
+
+			case 's':
+				nsizes = bench_parseList(optarg, sizes, 0, SERVERDEMO_SHM_MAX);
+				if (nsizes < 0) {
+					fprintf(stderr, "serverbench: invalid payload sizes\n");
+					return EXIT_FAILURE;
+				}
+				break;
+
+			case 'r':
+				bench_common.range = strtoll(optarg, NULL, 0);
+				break;
+
+			case 'a':
+				if (strcmp(optarg, "seq") == 0) {
+					bench_common.random = 0;
+				}
+				else if (strcmp(optarg, "rand") == 0) {
+					bench_common.random = 1;
+				}
+				else {
+					fprintf(stderr, "serverbench: invalid access pattern %s\n", optarg);
+					return EXIT_FAILURE;
+				}
+				break;
+
+			case 'x':
+				bench_common.method = benchPosix;
+				break;
+
+			case 'z':
+				bench_common.method = benchShm;
+				break;
+
+			case 'V':
+				bench_common.method = benchVec;
+				bench_common.nsegs = strtoul(optarg, NULL, 0);
+				if ((bench_common.nsegs == 0) || (bench_common.nsegs > SERVERDEMO_SEGS_MAX)) {
+					fprintf(stderr, "serverbench: invalid number of segments\n");
+					return EXIT_FAILURE;
+				}
+				break;
+
+			case 'W':
+				bench_common.method = benchPoll;
+				break;
+
+			case 'c':
+				nclients = bench_parseList(optarg, clients, 1, BENCH_CLIENTS_MAX);
+				if (nclients < 0) {
+					fprintf(stderr, "serverbench: invalid number of clients\n");
+					return EXIT_FAILURE;
+				}
+				break;
+
+			case 't':
+				seconds = strtoul(optarg, NULL, 0);
+				break;
+
+			case 'C':
+				csv = 1;
+				break;
+
+			case 'h':
+				bench_usage(argv[0]);
+				return EXIT_SUCCESS;
+
+			default:
+				bench_usage(argv[0]);
+				return EXIT_FAILURE;
+		}
+	}
+
+	if (path == NULL) {
+		path = (bench_common.method == benchPoll) ? "/dev/serverdemo-fifo" : "/dev/serverdemo";
+	}
+
+	if (lookup(path, NULL, &bench_common.oid) < 0) {
+		fprintf(stderr, "serverbench: %s not found\n", path);
+		return EXIT_FAILURE;
+	}
+
+	if (csv != 0) {
+		printf("method,op,pattern,size,clients,requests,time_us,rate,kibps,p50_ns,p99_ns,p999_ns,max_ns,rejected,segs\n");
+	}
+
+	if (bench_common.method == benchPoll) {
+		err = bench_poll(seconds, path, &res);
+		if (err < 0) {
+			fprintf(stderr, "serverbench: poll test failed with %d (%s)\n", err, strerror(-err));
+			return EXIT_FAILURE;
+		}
+
+		bench_print(&res, csv);
+		return EXIT_SUCCESS;
+	}
+
+	for (i = 0; i < nsizes; ++i) {
+		for (j = 0; j < nclients; ++j) {
+			bench_common.size = sizes[i];
+
+			err = bench_run(clients[j], seconds, path, &res);
+			if (err < 0) {
+				fprintf(stderr, "serverbench: size %lu, %lu clients failed with %d (%s)\n", sizes[i], clients[j], err, strerror(-err));
+				return EXIT_FAILURE;
+			}
+
+			bench_print(&res, csv);
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,181 @@
+/*
+ * Phoenix-RTOS
+ *
+ * Server demo
+ *
+ * Asynchronous request log
+ *
+ * Copyright 2026 Phoenix Systems
+ *
+ * This file is part of Phoenix-RTOS.
+ *
+ * %LICENSE%
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <sys/threads.h>
+
+#include "alog.h"
+
+
+#define ALOG_SLOTS    64 /* power of 2 */
+#define ALOG_DATA_MAX 64
+#define ALOG_PRIO     6
+#define ALOG_STACKSZ  4096
+#define ALOG_IDLE_US  10000
+
+
+typedef struct {
+	int type;
+	oid_t oid;
+	size_t len;
+	off_t offs;
+	unsigned char data[ALOG_DATA_MAX];
+} alog_entry_t;
+
+
+typedef struct {
+	/* Slot owner: equals position for producers, position + 1 for the consumer */
+	atomic_uint seq;
+	alog_entry_t entry;
+} alog_slot_t;
+
+
+static struct {
+	alog_slot_t slots[ALOG_SLOTS];
+	atomic_uint head;
+	unsigned int tail;
+	atomic_uint count;
+	atomic_uint dropped;
+
+	int verbosity;
+	unsigned int sample;
+	char stack[ALOG_STACKSZ] __attribute__((aligned(8)));
+} alog_common;
+
+
+void alog_request(int type, const oid_t *oid, const void *data, size_t len, off_t offs)
+{
+	alog_slot_t *slot;
+	unsigned int pos, seq;
+
+	if (alog_common.verbosity == alogOff) {
+		return;
+	}
+
+	if ((alog_common.sample > 1) && ((atomic_fetch_add_explicit(&alog_common.count, 1, memory_order_relaxed) % alog_common.sample) != 0)) {
+		return;
+	}
+
+	/* Claim a free slot (bounded multi-producer queue) */
+	pos = atomic_load_explicit(&alog_common.head, memory_order_relaxed);
+	for (;;) {
+		slot = &alog_common.slots[pos % ALOG_SLOTS];
+		seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+
+		if (seq == pos) {
+			if (atomic_compare_exchange_weak_explicit(&alog_common.head, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed)) {
+				break;
+			}
+		}
+		else if ((int)(seq - pos) < 0) {
+			/* Full, don't wait for the console */
+			atomic_fetch_add_explicit(&alog_common.dropped, 1, memory_order_relaxed);
+			return;
+		}
+		else {
+			pos = atomic_load_explicit(&alog_common.head, memory_order_relaxed);
+		}
+	}
+
+	slot->entry.type = type;
+	slot->entry.oid = *oid;
+	slot->entry.len = len;
+	slot->entry.offs = offs;
+	if ((alog_common.verbosity >= alogData) && (data != NULL)) {
+		memcpy(slot->entry.data, data, (len < ALOG_DATA_MAX) ? len : ALOG_DATA_MAX);
+	}
+
+	atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+}
+
+
+static void alog_print(const alog_entry_t *entry, int verbosity)
+{
+	size_t i, j, len;
+
+	printf("serverdemo: %s oid %u:%u of %zu bytes @offset %lld\n",
+		(entry->type == mtWrite) ? "Write to" : "Read from",
+		(unsigned)entry->oid.port, (unsigned)entry->oid.id, entry->len, (long long)entry->offs);
+
+	if ((verbosity < alogData) || (entry->type != mtWrite)) {
+		return;
+	}
+
+	len = (entry->len < ALOG_DATA_MAX) ? entry->len : ALOG_DATA_MAX;
+
+	printf("Data:");
+	for (i = 0; i < len; i += 16) {
+		printf("\n%08x: ", (unsigned int)i);
+		for (j = 0; (j < 16) && ((i + j) < len); ++j) {
+			printf("%02x ", entry->data[i + j]);
+		}
+	}
+	if (entry->len > len) {
+		printf("\n(%zu more bytes)", entry->len - len);
+	}
+	printf("\n");
+}
+
+
+static void alog_thread(void *arg)
+{
+	unsigned int dropped, reported = 0;
+	alog_slot_t *slot;
+
+	(void)arg;
+
+	for (;;) {
+		slot = &alog_common.slots[alog_common.tail % ALOG_SLOTS];
+
+		if (atomic_load_explicit(&slot->seq, memory_order_acquire) == alog_common.tail + 1) {
+			alog_print(&slot->entry, alog_common.verbosity);
+
+			/* Hand the slot back to producers for the next lap */
+			atomic_store_explicit(&slot->seq, alog_common.tail + ALOG_SLOTS, memory_order_release);
+			alog_common.tail++;
+			continue;
+		}
+
+		dropped = atomic_load_explicit(&alog_common.dropped, memory_order_relaxed);
+		if (dropped != reported) {
+			printf("serverdemo: %u log records dropped\n", dropped - reported);
+			reported = dropped;
+		}
+
+		usleep(ALOG_IDLE_US);
+	}
+}
+
+
+int alog_init(int verbosity, unsigned int sample)
+{
+	unsigned int i;
+
+	alog_common.verbosity = verbosity;
+	alog_common.sample = sample;
+
+	if (verbosity == alogOff) {
+		return 0;
+	}
+
+	for (i = 0; i < ALOG_SLOTS; ++i) {
+		atomic_init(&alog_common.slots[i].seq, i);
+	}
+
+	return beginthread(alog_thread, ALOG_PRIO, alog_common.stack, sizeof(alog_common.stack), NULL);
+}
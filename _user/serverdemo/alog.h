@@ -0,0 +1,35 @@
+/*
+ * Phoenix-RTOS
+ *
+ * Server demo
+ *
+ * Asynchronous request log
+ *
+ * Copyright 2026 Phoenix Systems
+ *
+ * This file is part of Phoenix-RTOS.
+ *
+ * %LICENSE%
+ */
+
+#ifndef _SERVERDEMO_ALOG_H_
+#define _SERVERDEMO_ALOG_H_
+
+#include <sys/types.h>
+#include <sys/msg.h>
+
+
+/* Verbosity levels */
+enum { alogOff = 0, alogHeader, alogData };
+
+
+/* Queues a request record, never blocks. Records are dropped (and counted)
+ * when the drain thread can't keep up. */
+extern void alog_request(int type, const oid_t *oid, const void *data, size_t len, off_t offs);
+
+
+/* Starts the low priority drain thread. Every sample-th request is logged. */
+extern int alog_init(int verbosity, unsigned int sample);
+
+
+#endif
@@ -0,0 +1,262 @@
+/*
+ * Phoenix-RTOS
+ *
+ * Server demo
+ *
+ * Page cache with sequential readahead
+ *
+ * Copyright 2026 Phoenix Systems
+ *
+ * This file is part of Phoenix-RTOS.
+ *
+ * %LICENSE%
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "cache.h"
+
+
+static cache_page_t *cache_set(cache_t *cache, id_t id, off_t idx)
+{
+	uint64_t h = ((uint64_t)id * 0x9e3779b97f4a7c15ULL) ^ (uint64_t)idx;
+
+	return &cache->pages[(h % cache->nsets) * CACHE_WAYS];
+}
+
+
+static cache_page_t *cache_find(cache_t *cache, id_t id, off_t idx)
+{
+	cache_page_t *set = cache_set(cache, id, idx);
+	unsigned int i;
+
+	for (i = 0; i < CACHE_WAYS; ++i) {
+		if ((set[i].valid != 0) && (set[i].id == id) && (set[i].idx == idx)) {
+			set[i].stamp = ++cache->stamp;
+			return &set[i];
+		}
+	}
+
+	return NULL;
+}
+
+
+/* Returns the least recently used page of the set */
+static cache_page_t *cache_victim(cache_t *cache, id_t id, off_t idx)
+{
+	cache_page_t *set = cache_set(cache, id, idx), *victim = &set[0];
+	unsigned int i;
+
+	for (i = 0; i < CACHE_WAYS; ++i) {
+		if (set[i].valid == 0) {
+			return &set[i];
+		}
+		if ((int)(set[i].stamp - victim->stamp) < 0) {
+			victim = &set[i];
+		}
+	}
+
+	return victim;
+}
+
+
+/* Reads npages pages starting at idx with a single store access,
+ * pages already in the cache are left intact */
+static cache_page_t *cache_fill(cache_t *cache, cache_file_t *file, off_t idx, unsigned int npages)
+{
+	cache_page_t *page = NULL;
+	off_t offs = idx * CACHE_PAGESZ;
+	size_t len, valid;
+	ssize_t ret;
+	unsigned int i;
+
+	len = (size_t)npages * CACHE_PAGESZ;
+	if ((off_t)len > file->size - offs) {
+		len = file->size - offs;
+	}
+
+	ret = store_read(cache->store, cache->buf, len, file->base + offs);
+	if (ret <= 0) {
+		return NULL;
+	}
+
+	/* Insert backwards, so the requested page is the most recently used one */
+	for (i = (ret - 1) / CACHE_PAGESZ + 1; i-- > 0;) {
+		if ((i != 0) && (cache_find(cache, file->id, idx + i) != NULL)) {
+			continue;
+		}
+
+		valid = (size_t)ret - i * CACHE_PAGESZ;
+		page = cache_victim(cache, file->id, idx + i);
+		page->id = file->id;
+		page->idx = idx + i;
+		page->valid = (valid < CACHE_PAGESZ) ? valid : CACHE_PAGESZ;
+		page->stamp = ++cache->stamp;
+		memcpy(page->data, cache->buf + i * CACHE_PAGESZ, page->valid);
+	}
+
+	return page;
+}
+
+
+ssize_t cache_read(cache_t *cache, cache_file_t *file, void *data, size_t len, off_t offs)
+{
+	cache_page_t *page;
+	size_t done = 0, n, poffs;
+	off_t idx;
+
+	if ((offs < 0) || (offs >= file->size)) {
+		return (offs < 0) ? -EINVAL : 0;
+	}
+
+	if ((off_t)len > file->size - offs) {
+		len = file->size - offs;
+	}
+
+	/* The store is accessed with the lock held, it keeps the cache simple
+	 * at the cost of serializing misses */
+	mutexLock(cache->lock);
+
+	/* Sequential access doubles the readahead window, any other resets it.
+	 * The first read of a file starts with a single page. */
+	if ((offs == file->raNext) && (file->raWindow != 0)) {
+		file->raWindow = (file->raWindow < CACHE_RA_MAX / 2) ? 2 * file->raWindow : CACHE_RA_MAX;
+	}
+	else {
+		file->raWindow = 1;
+	}
+	file->raNext = offs + len;
+
+	while (done < len) {
+		idx = (offs + done) / CACHE_PAGESZ;
+		poffs = (offs + done) % CACHE_PAGESZ;
+
+		page = cache_find(cache, file->id, idx);
+		if (page != NULL) {
+			cache->hits++;
+		}
+		else {
+			cache->misses++;
+			page = cache_fill(cache, file, idx, file->raWindow);
+			if (page == NULL) {
+				break;
+			}
+		}
+
+		if (page->valid <= poffs) {
+			break;
+		}
+
+		n = page->valid - poffs;
+		if (n > len - done) {
+			n = len - done;
+		}
+
+		memcpy((unsigned char *)data + done, page->data + poffs, n);
+		done += n;
+	}
+
+	mutexUnlock(cache->lock);
+
+	return (ssize_t)done;
+}
+
+
+ssize_t cache_write(cache_t *cache, cache_file_t *file, const void *data, size_t len, off_t offs)
+{
+	cache_page_t *page;
+	size_t done = 0, n, poffs;
+	ssize_t ret;
+	off_t idx;
+
+	if ((offs < 0) || (offs >= file->size)) {
+		return (offs < 0) ? -EINVAL : -ENOSPC;
+	}
+
+	if ((off_t)len > file->size - offs) {
+		len = file->size - offs;
+	}
+
+	mutexLock(cache->lock);
+
+	ret = store_write(cache->store, data, len, file->base + offs);
+	if (ret > 0) {
+		while (done < (size_t)ret) {
+			idx = (offs + done) / CACHE_PAGESZ;
+			poffs = (offs + done) % CACHE_PAGESZ;
+			n = CACHE_PAGESZ - poffs;
+			if (n > (size_t)ret - done) {
+				n = (size_t)ret - done;
+			}
+
+			page = cache_find(cache, file->id, idx);
+			if (page != NULL) {
+				if (poffs <= page->valid) {
+					memcpy(page->data + poffs, (const unsigned char *)data + done, n);
+					if (poffs + n > page->valid) {
+						page->valid = poffs + n;
+					}
+				}
+				else {
+					/* Write past the cached part, drop the page */
+					page->valid = 0;
+				}
+			}
+
+			done += n;
+		}
+	}
+
+	mutexUnlock(cache->lock);
+
+	return ret;
+}
+
+
+void cache_done(cache_t *cache)
+{
+	unsigned int i;
+
+	if (cache->pages != NULL) {
+		for (i = 0; i < cache->nsets * CACHE_WAYS; ++i) {
+			free(cache->pages[i].data);
+		}
+		free(cache->pages);
+	}
+	free(cache->buf);
+	resourceDestroy(cache->lock);
+}
+
+
+int cache_init(cache_t *cache, store_t *store, unsigned int npages)
+{
+	unsigned int i;
+
+	memset(cache, 0, sizeof(*cache));
+	cache->store = store;
+	cache->nsets = (npages + CACHE_WAYS - 1) / CACHE_WAYS;
+
+	if (mutexCreate(&cache->lock) < 0) {
+		return -ENOMEM;
+	}
+
+	cache->pages = calloc(cache->nsets * CACHE_WAYS, sizeof(cache_page_t));
+	cache->buf = malloc(CACHE_RA_MAX * CACHE_PAGESZ);
+	if ((cache->pages == NULL) || (cache->buf == NULL)) {
+		cache_done(cache);
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < cache->nsets * CACHE_WAYS; ++i) {
+		cache->pages[i].data = malloc(CACHE_PAGESZ);
+		if (cache->pages[i].data == NULL) {
+			cache_done(cache);
+			return -ENOMEM;
+		}
+	}
+
+	return 0;
+}
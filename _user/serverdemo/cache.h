@@ -0,0 +1,77 @@
+/*
+ * Phoenix-RTOS
+ *
+ * Server demo
+ *
+ * Page cache with sequential readahead
+ *
+ * Copyright 2026 Phoenix Systems
+ *
+ * This file is part of Phoenix-RTOS.
+ *
+ * %LICENSE%
+ */
+
+#ifndef _SERVERDEMO_CACHE_H_
+#define _SERVERDEMO_CACHE_H_
+
+#include <sys/types.h>
+#include <sys/threads.h>
+
+#include "store.h"
+
+
+#define CACHE_PAGESZ 4096
+#define CACHE_WAYS   4
+#define CACHE_RA_MAX 8 /* Maximum readahead window in pages */
+
+
+/* Part of the store seen as one cached file */
+typedef struct {
+	id_t id;
+	off_t base;
+	off_t size;
+
+	/* Readahead state, protected by the cache lock */
+	off_t raNext;
+	unsigned int raWindow;
+} cache_file_t;
+
+
+typedef struct {
+	id_t id;
+	off_t idx;     /* Page index within the file */
+	size_t valid;  /* Number of valid bytes, 0 - empty page */
+	unsigned int stamp;
+	unsigned char *data;
+} cache_page_t;
+
+
+typedef struct {
+	handle_t lock;
+	store_t *store;
+	cache_page_t *pages; /* nsets * CACHE_WAYS */
+	unsigned int nsets;
+	unsigned int stamp;
+	unsigned char *buf; /* Readahead staging buffer */
+
+	unsigned long hits;
+	unsigned long misses;
+} cache_t;
+
+
+extern ssize_t cache_read(cache_t *cache, cache_file_t *file, void *data, size_t len, off_t offs);
+
+
+/* Writes through to the store, cached pages are updated */
+extern ssize_t cache_write(cache_t *cache, cache_file_t *file, const void *data, size_t len, off_t offs);
+
+
+extern void cache_done(cache_t *cache);
+
+
+/* Creates a cache of npages pages in front of store */
+extern int cache_init(cache_t *cache, store_t *store, unsigned int npages);
+
+
+#endif
@@ -17,7 +17,13 @@
 #include <string.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <poll.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
 #include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/threads.h>
 
 /* Message handling */
 #include <sys/msg.h>
@@ -25,135 +31,778 @@
 /* create_dev() */
 #include <posix/utils.h>
 
+#include "serverdemo.h"
+#include "alog.h"
+#include "cache.h"
+#include "srv.h"
+#include "store.h"
+#include "trace.h"
+#include "wb.h"
 
-static int server_handleOpen(oid_t *oid)
+
+#define SERVER_NAME_LEN    32
+#define SERVER_CACHE_PAGES 32
+#define SERVER_SHM_REGIONS 4
+#define SERVER_FIFO_SIZE   4096
+#define SERVER_STATS_SIZE  4096
+
+
+typedef struct {
+	srv_obj_t obj;
+
+	/* Serializes requests that touch the object state. Requests that
+	 * don't (open, close, read) are handled in parallel. */
+	handle_t lock;
+	off_t offs; /* End of the last write */
+
+	/* Part of the backing store served by the object */
+	cache_file_t file;
+	wb_buf_t wb;
+
+	/* Statistics, updated without the lock */
+	atomic_ulong nreads;
+	atomic_ulong nwrites;
+	atomic_ulong rbytes;
+	atomic_ulong wbytes;
+} server_obj_t;
+
+
+/* Pipe-like object, reads wait for data without holding a server thread */
+typedef struct {
+	srv_obj_t obj;
+	handle_t lock;
+	size_t head;
+	size_t len;
+	unsigned char buf[SERVER_FIFO_SIZE];
+} server_fifo_t;
+
+
+/* Request latency report, regenerated by a read at offset 0 */
+typedef struct {
+	srv_obj_t obj;
+	handle_t lock;
+	size_t len;
+	char *buf;
+} server_stats_t;
+
+
+static struct {
+	srv_t srv;
+	server_obj_t *objs;
+	unsigned int nobjs;
+	server_fifo_t fifo;
+	server_stats_t stats; /* Only with tracing or admission control enabled */
+
+	store_t store; /* Empty - no backing store */
+	cache_t cache;
+	unsigned int cachePages;
+	time_t wbTimeout; /* 0 - write-through */
+
+	/* Shared memory regions for bulk transfers */
+	handle_t shmLock;
+	struct {
+		void *va; /* NULL - free */
+		addr_t pa;
+		size_t size;
+		unsigned int pid;  /* Owner */
+		unsigned int refs; /* Transfers in progress */
+	} shm[SERVER_SHM_REGIONS];
+} server_common;
+
+
+static ssize_t server_storeRead(server_obj_t *sobj, void *data, size_t len, off_t offset)
+{
+	if (server_common.cachePages != 0) {
+		return cache_read(&server_common.cache, &sobj->file, data, len, offset);
+	}
+
+	if ((offset < 0) || (offset >= sobj->file.size)) {
+		return (offset < 0) ? -EINVAL : 0;
+	}
+
+	if ((off_t)len > sobj->file.size - offset) {
+		len = sobj->file.size - offset;
+	}
+
+	return store_read(&server_common.store, data, len, sobj->file.base + offset);
+}
+
+
+/* Called with the object lock held */
+static ssize_t server_storeWrite(void *arg, const void *data, size_t len, off_t offset)
+{
+	server_obj_t *sobj = arg;
+
+	if (server_common.store.size == 0) {
+		/* No backing store, data is discarded */
+		return (ssize_t)len;
+	}
+
+	if (server_common.cachePages != 0) {
+		return cache_write(&server_common.cache, &sobj->file, data, len, offset);
+	}
+
+	if ((offset < 0) || (offset >= sobj->file.size)) {
+		return (offset < 0) ? -EINVAL : -ENOSPC;
+	}
+
+	if ((off_t)len > sobj->file.size - offset) {
+		len = sobj->file.size - offset;
+	}
+
+	return store_write(&server_common.store, data, len, sobj->file.base + offset);
+}
+
+
+static int server_handleOpen(srv_obj_t *obj, int flags)
 {
 	/* Just allow open() on our interface.
 	 * We need to handle this to allow open()
 	 * to work with our server. */
-	(void)oid;
+	(void)obj;
+	(void)flags;
 	return 0;
 }
 
 
-static int server_handleClose(oid_t *oid)
+static int server_handleSync(srv_obj_t *obj)
 {
-	/* Just allow close() on our interface.
-	 * We need to handle this to allow close()
-	 * to work with our server. */
-	(void)oid;
-	return 0;
+	server_obj_t *sobj = (server_obj_t *)obj;
+	int err;
+
+	/* Write out data buffered by write-back. */
+	mutexLock(sobj->lock);
+	err = wb_flush(&sobj->wb);
+	mutexUnlock(sobj->lock);
+
+	return err;
 }
 
 
-static ssize_t server_handleRead(oid_t *oid, void *data, size_t len, off_t offset)
+static int server_handleClose(srv_obj_t *obj)
 {
-	/* This is where we handle read request (i.e. user is reading from the server). */
-	printf("serverdemo: Read from oid %u:%u of %zu bytes @offset %lld\n",
-		(unsigned)oid->port, (unsigned)oid->id, len, (long long)offset);
+	/* Allow close() on our interface. We need to handle this
+	 * to allow close() to work with our server. Buffered data
+	 * is written out, the user gets the error if it fails. */
+	return server_handleSync(obj);
+}
 
-	/* Put something into the requester buffer. */
-	memset(data, 'x', len);
 
-	/* Actual read length or error (negative value). */
-	return (ssize_t)len;
+static int server_handleGetAttr(srv_obj_t *obj, int type, long long *val)
+{
+	server_obj_t *sobj = (server_obj_t *)obj;
+
+	switch (type) {
+		case atSize:
+			*val = sobj->file.size;
+			return 0;
+
+		default:
+			return -EINVAL;
+	}
 }
 
 
-static ssize_t server_handleWrite(oid_t *oid, const void *data, size_t len, off_t offset)
+static ssize_t server_handleRead(srv_obj_t *obj, void *data, size_t len, off_t offset)
 {
-	/* This is where we handle write request (i.e. user is writing to the server). */
-	printf("serverdemo: Write to oid %u:%u of %zu bytes @offset %lld\n",
-		(unsigned)oid->port, (unsigned)oid->id, len, (long long)offset);
+	server_obj_t *sobj = (server_obj_t *)obj;
+	oid_t oid = { .port = server_common.srv.port, .id = obj->id };
+	ssize_t ret;
+
+	/* This is where we handle read request (i.e. user is reading from the server).
+	 * Printing to the console here would make the response time depend on
+	 * the console speed, so the request is only queued to the log. */
+	alog_request(mtRead, &oid, NULL, len, offset);
 
-	/* Print out received data. */
-	printf("Data:");
-	for (size_t i = 0; i < len; i += 16) {
-		printf("\n%08x: ", (unsigned int)i);
-		for (size_t j = 0; (j < 16) && ((i + j) < len); ++j) {
-			printf("%02x ", ((unsigned char *)data)[i + j]);
+	if (server_common.store.size == 0) {
+		/* No backing store, put something into the requester buffer. */
+		memset(data, 'x', len);
+		ret = (ssize_t)len;
+	}
+	else {
+		/* Reads have to see the buffered writes */
+		ret = wb_sync(&sobj->wb);
+		if (ret == 0) {
+			ret = server_storeRead(sobj, data, len, offset);
 		}
 	}
-	printf("\n");
+
+	if (ret > 0) {
+		atomic_fetch_add_explicit(&sobj->nreads, 1, memory_order_relaxed);
+		atomic_fetch_add_explicit(&sobj->rbytes, ret, memory_order_relaxed);
+	}
+
+	/* Actual read length or error (negative value). */
+	return ret;
+}
+
+
+static ssize_t server_handleWrite(srv_obj_t *obj, const void *data, size_t len, off_t offset)
+{
+	server_obj_t *sobj = (server_obj_t *)obj;
+	oid_t oid = { .port = server_common.srv.port, .id = obj->id };
+	ssize_t ret;
+
+	/* This is where we handle write request (i.e. user is writing to the server).
+	 * Writes to the same object are serialized, other requests run in parallel. */
+	mutexLock(sobj->lock);
+
+	/* Queue the received data to be dumped by the log thread. */
+	alog_request(mtWrite, &oid, data, len, offset);
+
+	if (server_common.wbTimeout != 0) {
+		/* Small adjacent writes are coalesced and written out later */
+		ret = wb_write(&sobj->wb, data, len, offset);
+	}
+	else {
+		ret = server_storeWrite(sobj, data, len, offset);
+	}
+
+	if (ret > 0) {
+		sobj->offs = offset + ret;
+	}
+
+	mutexUnlock(sobj->lock);
+
+	if (ret > 0) {
+		atomic_fetch_add_explicit(&sobj->nwrites, 1, memory_order_relaxed);
+		atomic_fetch_add_explicit(&sobj->wbytes, ret, memory_order_relaxed);
+	}
 
 	/* Actual write length or error (negative value). */
-	return (ssize_t)len;
+	return ret;
 }
 
 
-__attribute__((noreturn)) static void server_msgLoop(oid_t *oid)
+static int server_shmMap(unsigned int pid, size_t size, serverdemo_devctlo_t *out)
 {
-	/* This is a message structure. It is filled-in by kernel during
-	 * msgRecv() syscall. It contains all data necessary to handle
-	 * the request. */
-	msg_t msg;
+	unsigned int i;
+	void *va;
 
-	/* This is a message response ID. It allows the kernel to distinguish
-	 * between messages passed to the server when the server is responding.
-	 * It is needed, because the server might be handling more than one
-	 * message in parallel at any given time, so the kernel needs an
-	 * information, to which user the server it responding. */
-	msg_rid_t rid;
+	if ((size == 0) || (size > SERVERDEMO_SHM_MAX)) {
+		return -EINVAL;
+	}
 
-	for (;;) {
-		/* Receive the next message. This call will block until a message
-		 * becomes available. It can be interrupted by a posix signal. */
-		int err = msgRecv(oid->port, &msg, &rid);
-		if (err < 0) {
-			if (err == -EINTR) {
-				/* We were interrupted by a posix signal. So we
-				 * just try again to receive a valid message. */
-				continue;
+	size = (size + _PAGE_SIZE - 1) & ~(_PAGE_SIZE - 1);
+
+	/* Physically contiguous, so the client can map it by its physical address */
+	va = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_CONTIGUOUS, -1, 0);
+	if (va == MAP_FAILED) {
+		return -ENOMEM;
+	}
+
+	mutexLock(server_common.shmLock);
+	for (i = 0; i < SERVER_SHM_REGIONS; ++i) {
+		if (server_common.shm[i].va == NULL) {
+			server_common.shm[i].va = va;
+			server_common.shm[i].pa = va2pa(va);
+			server_common.shm[i].size = size;
+			server_common.shm[i].pid = pid;
+			server_common.shm[i].refs = 0;
+
+			out->region = i;
+			out->paddr = server_common.shm[i].pa;
+			out->size = size;
+			break;
+		}
+	}
+	mutexUnlock(server_common.shmLock);
+
+	if (i == SERVER_SHM_REGIONS) {
+		munmap(va, size);
+		return -ENOSPC;
+	}
+
+	return 0;
+}
+
+
+static int server_shmUnmap(unsigned int pid, unsigned int region)
+{
+	void *va = NULL;
+	size_t size = 0;
+	int err = -EINVAL;
+
+	mutexLock(server_common.shmLock);
+	if ((region < SERVER_SHM_REGIONS) && (server_common.shm[region].va != NULL) && (server_common.shm[region].pid == pid)) {
+		if (server_common.shm[region].refs != 0) {
+			err = -EBUSY;
+		}
+		else {
+			va = server_common.shm[region].va;
+			size = server_common.shm[region].size;
+			server_common.shm[region].va = NULL;
+			err = 0;
+		}
+	}
+	mutexUnlock(server_common.shmLock);
+
+	if (va != NULL) {
+		munmap(va, size);
+	}
+
+	return err;
+}
+
+
+/* Returns the part of the client region described by the request, holding a reference to it */
+static void *server_shmGet(unsigned int pid, unsigned int region, size_t offs, size_t len)
+{
+	void *va = NULL;
+
+	mutexLock(server_common.shmLock);
+	if ((region < SERVER_SHM_REGIONS) && (server_common.shm[region].va != NULL) && (server_common.shm[region].pid == pid) &&
+			(offs <= server_common.shm[region].size) && (len <= server_common.shm[region].size - offs)) {
+		server_common.shm[region].refs++;
+		va = (unsigned char *)server_common.shm[region].va + offs;
+	}
+	mutexUnlock(server_common.shmLock);
+
+	return va;
+}
+
+
+static void server_shmPut(unsigned int region)
+{
+	mutexLock(server_common.shmLock);
+	server_common.shm[region].refs--;
+	mutexUnlock(server_common.shmLock);
+}
+
+
+/* Transfers all segments of a vectored request in one call. Stops at the
+ * first short or failed segment, like readv()/writev(). */
+static int server_handleVec(srv_req_t *req, const serverdemo_devctl_t *in)
+{
+	const serverdemo_seg_t *segs = req->msg.i.data;
+	srv_obj_t *obj = req->obj;
+	unsigned char *data;
+	size_t hdr, size, total = 0;
+	unsigned int i;
+	ssize_t ret;
+
+	if (obj == NULL) {
+		return -ENOENT;
+	}
+
+	hdr = (size_t)in->vec.nsegs * sizeof(serverdemo_seg_t);
+	if ((in->vec.nsegs == 0) || (in->vec.nsegs > SERVERDEMO_SEGS_MAX) || (req->msg.i.size < hdr)) {
+		return -EINVAL;
+	}
+
+	if (in->type == serverdemo_readv) {
+		if (obj->ops->read == NULL) {
+			return -ENOSYS;
+		}
+		data = req->msg.o.data;
+		size = req->msg.o.size;
+	}
+	else {
+		if (obj->ops->write == NULL) {
+			return -ENOSYS;
+		}
+		data = (unsigned char *)req->msg.i.data + hdr;
+		size = req->msg.i.size - hdr;
+	}
+
+	for (i = 0; i < in->vec.nsegs; ++i) {
+		if (segs[i].len > size - total) {
+			return -EINVAL;
+		}
+		total += segs[i].len;
+	}
+
+	for (i = 0, total = 0; i < in->vec.nsegs; ++i) {
+		if (in->type == serverdemo_readv) {
+			ret = obj->ops->read(obj, data + total, segs[i].len, segs[i].offs);
+		}
+		else {
+			ret = obj->ops->write(obj, data + total, segs[i].len, segs[i].offs);
+		}
+
+		/* Only a request which didn't transfer anything yet can wait (SRV_DEFERRED) */
+		if (ret < 0) {
+			return (total != 0) ? (int)total : (int)ret;
+		}
+
+		total += ret;
+		if ((size_t)ret < segs[i].len) {
+			break;
+		}
+	}
+
+	return (int)total;
+}
+
+
+/* Bulk transfers: the payload stays in a region shared with the client,
+ * messages carry only its descriptors, so the kernel doesn't need to map
+ * the client buffer into the server for every message */
+static int server_handleDevCtl(srv_t *srv, srv_req_t *req)
+{
+	const serverdemo_devctl_t *in = (const serverdemo_devctl_t *)req->msg.i.raw;
+	serverdemo_devctlo_t *out = (serverdemo_devctlo_t *)req->msg.o.raw;
+	void *va;
+	int err;
+
+	(void)srv;
+
+	switch (in->type) {
+		case serverdemo_shmMap:
+			return server_shmMap(req->msg.pid, in->map.size, out);
+
+		case serverdemo_shmUnmap:
+			return server_shmUnmap(req->msg.pid, in->region);
+
+		case serverdemo_shmRead:
+		case serverdemo_shmWrite:
+			if (req->obj == NULL) {
+				return -ENOENT;
+			}
+
+			if (((in->type == serverdemo_shmRead) && (req->obj->ops->read == NULL)) ||
+					((in->type == serverdemo_shmWrite) && (req->obj->ops->write == NULL))) {
+				return -ENOSYS;
+			}
+
+			va = server_shmGet(req->msg.pid, in->region, in->io.shmOffs, in->io.len);
+			if (va == NULL) {
+				return -EINVAL;
+			}
+
+			/* Any object type, the FIFO can return SRV_DEFERRED. The parked
+			 * request holds no region reference, it looks the region up again
+			 * when it's handled after srv_wakeup(). */
+			if (in->type == serverdemo_shmRead) {
+				err = req->obj->ops->read(req->obj, va, in->io.len, in->io.offs);
 			}
 			else {
-				/* Some serious error occurred. We end the server
-				 * process as we're unable to process messages. */
-				fprintf(stderr, "serverdemo: msgRecv returned %d (%s)\n", err, strerror(err));
-				exit(EXIT_FAILURE);
+				err = req->obj->ops->write(req->obj, va, in->io.len, in->io.offs);
+			}
+
+			server_shmPut(in->region);
+			return err;
+
+		case serverdemo_readv:
+		case serverdemo_writev:
+			return server_handleVec(req, in);
+
+		default:
+			return -ENOSYS;
+	}
+}
+
+
+/* Handlers of our special file. The server framework finds the object
+ * addressed by the message oid and calls the handler for the message type.
+ * Other message types can be handled by srv_register(). */
+static const srv_ops_t server_ops = {
+	.open = server_handleOpen,
+	.close = server_handleClose,
+	.read = server_handleRead,
+	.write = server_handleWrite,
+	.sync = server_handleSync,
+	.getattr = server_handleGetAttr,
+};
+
+
+static ssize_t server_fifoRead(srv_obj_t *obj, void *data, size_t len, off_t offset)
+{
+	server_fifo_t *fifo = (server_fifo_t *)obj;
+	size_t n, chunk;
+
+	(void)offset;
+
+	if (len == 0) {
+		return 0;
+	}
+
+	mutexLock(fifo->lock);
+	if (fifo->len == 0) {
+		mutexUnlock(fifo->lock);
+
+		/* No data yet. The request is parked by the server framework
+		 * and handled again when a writer wakes up the FIFO. */
+		return SRV_DEFERRED;
+	}
+
+	n = (len < fifo->len) ? len : fifo->len;
+	chunk = (n < SERVER_FIFO_SIZE - fifo->head) ? n : SERVER_FIFO_SIZE - fifo->head;
+	memcpy(data, fifo->buf + fifo->head, chunk);
+	memcpy((unsigned char *)data + chunk, fifo->buf, n - chunk);
+	fifo->head = (fifo->head + n) % SERVER_FIFO_SIZE;
+	fifo->len -= n;
+	srv_objEvents(obj, POLLOUT, (fifo->len == 0) ? POLLIN : 0);
+	mutexUnlock(fifo->lock);
+
+	return (ssize_t)n;
+}
+
+
+static ssize_t server_fifoWrite(srv_obj_t *obj, const void *data, size_t len, off_t offset)
+{
+	server_fifo_t *fifo = (server_fifo_t *)obj;
+	size_t n, tail, chunk;
+
+	(void)offset;
+
+	mutexLock(fifo->lock);
+	n = SERVER_FIFO_SIZE - fifo->len;
+	if (n > len) {
+		n = len;
+	}
+
+	tail = (fifo->head + fifo->len) % SERVER_FIFO_SIZE;
+	chunk = (n < SERVER_FIFO_SIZE - tail) ? n : SERVER_FIFO_SIZE - tail;
+	memcpy(fifo->buf + tail, data, chunk);
+	memcpy(fifo->buf, (const unsigned char *)data + chunk, n - chunk);
+	fifo->len += n;
+	if (n != 0) {
+		srv_objEvents(obj, POLLIN, (fifo->len == SERVER_FIFO_SIZE) ? POLLOUT : 0);
+	}
+	mutexUnlock(fifo->lock);
+
+	if (n == 0) {
+		/* Full, writers don't wait */
+		return (len == 0) ? 0 : -EAGAIN;
+	}
+
+	/* Complete the reads waiting for data. Pollers see the FIFO
+	 * readable already, the kernel asks for it with atPollStatus. */
+	srv_wakeup(&server_common.srv, obj);
+
+	return (ssize_t)n;
+}
+
+
+static const srv_ops_t server_fifoOps = {
+	.read = server_fifoRead,
+	.write = server_fifoWrite,
+};
+
+
+static ssize_t server_statsRead(srv_obj_t *obj, void *data, size_t len, off_t offset)
+{
+	server_stats_t *stats = (server_stats_t *)obj;
+
+	if (offset < 0) {
+		return -EINVAL;
+	}
+
+	mutexLock(stats->lock);
+	if (offset == 0) {
+		stats->len = (server_common.srv.trace != 0) ? trace_report(stats->buf, SERVER_STATS_SIZE) : 0;
+		if (server_common.srv.admission != 0) {
+			stats->len += snprintf(stats->buf + stats->len, SERVER_STATS_SIZE - stats->len, "rejected control %lu normal %lu bulk %lu\n",
+				srv_rejected(&server_common.srv, srvClassControl), srv_rejected(&server_common.srv, srvClassNormal),
+				srv_rejected(&server_common.srv, srvClassBulk));
+			if (stats->len >= SERVER_STATS_SIZE) {
+				stats->len = SERVER_STATS_SIZE - 1;
 			}
 		}
+	}
 
-		/* We got a message, now we need to process it. */
-		switch (msg.type) {
-			/* There are many other message types, as defined in
-			 * sys/msg.h header. In this example we will handle
-			 * only selected types. */
-			case mtOpen:
-				msg.o.err = server_handleOpen(&msg.oid);
-				break;
+	if ((size_t)offset >= stats->len) {
+		len = 0;
+	}
+	else if (len > stats->len - offset) {
+		len = stats->len - offset;
+	}
+	memcpy(data, stats->buf + offset, len);
+	mutexUnlock(stats->lock);
 
-			case mtClose:
-				msg.o.err = server_handleClose(&msg.oid);
-				break;
+	return (ssize_t)len;
+}
 
-			case mtRead:
-				/* Buffer in msg.o.data is provided by the user and
-				 * was allocated in the server memory space by the kernel. */
-				msg.o.err = server_handleRead(&msg.oid, msg.o.data, msg.o.size, msg.i.io.offs);
-				break;
 
-			case mtWrite:
-				/* Buffer in msg.i.data is provided by the user and
-				 * was allocated in the server memory space by the kernel. */
-				msg.o.err = server_handleWrite(&msg.oid, msg.i.data, msg.i.size, msg.i.io.offs);
-				break;
+/* Any write clears the histograms */
+static ssize_t server_statsWrite(srv_obj_t *obj, const void *data, size_t len, off_t offset)
+{
+	(void)obj;
+	(void)data;
+	(void)offset;
 
-			default:
-				/* All other types are not supported. */
-				msg.o.err = -ENOSYS;
-				break;
+	if (server_common.srv.trace != 0) {
+		trace_reset();
+	}
+
+	return (ssize_t)len;
+}
+
+
+static const srv_ops_t server_statsOps = {
+	.read = server_statsRead,
+	.write = server_statsWrite,
+};
+
+
+/* Transfers through shared memory and vectored ones are bulk too */
+static int server_classify(const msg_t *msg)
+{
+	const serverdemo_devctl_t *devctl = (const serverdemo_devctl_t *)msg->i.raw;
+
+	if ((msg->type == mtDevCtl) && ((devctl->type == serverdemo_shmRead) || (devctl->type == serverdemo_shmWrite))) {
+		return (devctl->io.len >= SRV_BULK_SIZE) ? srvClassBulk : srvClassNormal;
+	}
+
+	if ((msg->type == mtDevCtl) && ((devctl->type == serverdemo_readv) || (devctl->type == serverdemo_writev))) {
+		return (((devctl->type == serverdemo_readv) ? msg->o.size : msg->i.size) >= SRV_BULK_SIZE) ? srvClassBulk : srvClassNormal;
+	}
+
+	return srv_classify(msg);
+}
+
+
+/* Switch based dispatch, as servers usually do it - the reference for the benchmark */
+static void server_switchDispatch(srv_t *srv, srv_req_t *req)
+{
+	msg_t *msg = &req->msg;
+
+	req->obj = srv_objGet(srv, msg->oid.id);
+	if (req->obj == NULL) {
+		msg->o.err = -ENOENT;
+		return;
+	}
+
+	switch (msg->type) {
+		case mtOpen:
+			msg->o.err = server_handleOpen(req->obj, msg->i.openclose.flags);
+			break;
+
+		case mtClose:
+			msg->o.err = server_handleClose(req->obj);
+			break;
+
+		case mtRead:
+			msg->o.err = server_handleRead(req->obj, msg->o.data, msg->o.size, msg->i.io.offs);
+			break;
+
+		case mtWrite:
+			msg->o.err = server_handleWrite(req->obj, msg->i.data, msg->i.size, msg->i.io.offs);
+			break;
+
+		default:
+			msg->o.err = -ENOSYS;
+			break;
+	}
+}
+
+
+static unsigned long long server_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+/* Compares the dispatch cost of srv_dispatch() and a switch statement
+ * on a mix of message types, with empty payloads and logging disabled */
+static void server_benchDispatch(unsigned long iterations)
+{
+	static const int types[] = { mtRead, mtWrite, mtRead, mtGetAttr, mtRead, mtWrite, mtOpen, mtClose };
+	static srv_req_t reqs[sizeof(types) / sizeof(types[0])];
+	unsigned long long start, tswitch, ttable;
+	unsigned long i;
+	unsigned int j;
+	volatile int sink = 0;
+
+	for (j = 0; j < sizeof(types) / sizeof(types[0]); ++j) {
+		reqs[j].msg.type = types[j];
+		reqs[j].msg.oid.port = server_common.srv.port;
+		reqs[j].msg.oid.id = server_common.objs[0].obj.id;
+	}
+
+	start = server_now();
+	for (i = 0; i < iterations; ++i) {
+		for (j = 0; j < sizeof(types) / sizeof(types[0]); ++j) {
+			server_switchDispatch(&server_common.srv, &reqs[j]);
+			sink += reqs[j].msg.o.err;
 		}
+	}
+	tswitch = server_now() - start;
 
-		/* Now we respond to the message we just handled.
-		 * We pass the message that we received (modified by
-		 * processing it) back to the kernel, along with the
-		 * respond ID that we received from msgRecv(). */
-		msgRespond(oid->port, &msg, rid);
+	start = server_now();
+	for (i = 0; i < iterations; ++i) {
+		for (j = 0; j < sizeof(types) / sizeof(types[0]); ++j) {
+			srv_dispatch(&server_common.srv, &reqs[j]);
+			sink += reqs[j].msg.o.err;
+		}
 	}
+	ttable = server_now() - start;
+
+	i = iterations * (sizeof(types) / sizeof(types[0]));
+	printf("serverdemo: dispatch of %lu messages: switch %llu ns/msg, table %llu ns/msg\n",
+		i, tswitch / i, ttable / i);
+}
+
+
+/* Measures object lookup time for growing number of objects. Ids are
+ * sparse, so they can't be used as an array index. */
+static void server_benchLookup(unsigned long iterations)
+{
+	static const size_t counts[] = { 10, 1000, 100000 };
+	unsigned long long start, elapsed;
+	unsigned long i;
+	unsigned int k, seed = 1;
+	volatile uintptr_t sink = 0;
+	srv_obj_t *objs;
+	objtab_t tab;
+	size_t j, n;
+
+	for (k = 0; k < sizeof(counts) / sizeof(counts[0]); ++k) {
+		n = counts[k];
+
+		objs = calloc(n, sizeof(srv_obj_t));
+		if ((objs == NULL) || (objtab_init(&tab, n) < 0)) {
+			fprintf(stderr, "serverdemo: not enough memory for %zu objects\n", n);
+			free(objs);
+			return;
+		}
+
+		for (j = 0; j < n; ++j) {
+			objs[j].id = (id_t)j * 7919 + 3;
+			objtab_add(&tab, objs[j].id, &objs[j]);
+		}
+
+		start = server_now();
+		for (i = 0; i < iterations; ++i) {
+			seed = seed * 1103515245 + 12345;
+			sink += (uintptr_t)objtab_get(&tab, (id_t)((seed >> 8) % n) * 7919 + 3);
+		}
+		elapsed = server_now() - start;
+
+		printf("serverdemo: lookup in %zu objects: %llu ns/lookup\n", n, elapsed / iterations);
+
+		objtab_done(&tab);
+		free(objs);
+	}
+}
+
+
+static void server_usage(const char *progname)
+{
+	printf("Usage: %s [options]\n", progname);
+	printf("Options:\n");
+	printf("\t-t <threads>  number of threads handling messages (1-%u, default 1)\n", SRV_THREADS_MAX);
+	printf("\t-v <level>    log verbosity: 0 - off, 1 - requests, 2 - requests and data (default 2)\n");
+	printf("\t-s <n>        log every n-th request only (default 1)\n");
+	printf("\t-n <objects>  number of special files to create (default 1)\n");
+	printf("\t-r <size>     serve a RAM store of size bytes per special file\n");
+	printf("\t-f <path>     serve a file, split evenly between special files\n");
+	printf("\t-c <pages>    page cache size for -r/-f, 0 - no cache (default %u)\n", SERVER_CACHE_PAGES);
+	printf("\t-w <ms>       buffer small writes, flush them after ms milliseconds at the latest\n");
+	printf("\t-P <depth>    serve control requests ahead of bulk transfers, up to depth requests wait\n");
+	printf("\t-A <n>        with -P, reject bulk requests with n waiting or over depth\n");
+	printf("\t-T            trace requests, latency histograms and rejects are in /dev/serverdemo-stats\n");
+	printf("\t-B <n>        run n iterations of the dispatch and lookup benchmarks and exit\n");
+	printf("\t-h            print this help message\n");
 }
 
 
-int main(void)
+int main(int argc, char **argv)
 {
 	/* Our oid - unique object identifier that consists of:
 	 * port - a unique port, assigned by the kernel via portCreate(),
@@ -161,13 +810,206 @@ int main(void)
 	 * id   - a unique within each server identifier that identifies
 	 *        every special file created by the server. */
 	oid_t oid;
+	char name[SERVER_NAME_LEN];
+	unsigned int i, nthreads = 1, sample = 1, depth = 0, watermark = 0;
+	unsigned long bench = 0;
+	const char *path = NULL;
+	off_t size = 0;
+	int c, err, verbosity = alogData, trace = 0;
 
-	/* Assign id to zero, we only have one special file, so it doesn't matter. */
-	oid.id = 0;
+	server_common.cachePages = SERVER_CACHE_PAGES;
 
-	/* Create the port */
-	if (portCreate(&oid.port) < 0) {
-		fprintf(stderr, "serverdemo: portCreate failed\n");
+	while ((c = getopt(argc, argv, "t:v:s:n:r:f:c:w:P:A:TB:h")) != -1) {
+		switch (c) {
+			case 't':
+				nthreads = strtoul(optarg, NULL, 0);
+				if ((nthreads == 0) || (nthreads > SRV_THREADS_MAX)) {
+					fprintf(stderr, "serverdemo: invalid number of threads\n");
+					return EXIT_FAILURE;
+				}
+				break;
+
+			case 'v':
+				verbosity = strtol(optarg, NULL, 0);
+				break;
+
+			case 's':
+				sample = strtoul(optarg, NULL, 0);
+				break;
+
+			case 'n':
+				server_common.nobjs = strtoul(optarg, NULL, 0);
+				if (server_common.nobjs == 0) {
+					fprintf(stderr, "serverdemo: invalid number of objects\n");
+					return EXIT_FAILURE;
+				}
+				break;
+
+			case 'r':
+				size = strtoll(optarg, NULL, 0);
+				if (size <= 0) {
+					fprintf(stderr, "serverdemo: invalid store size\n");
+					return EXIT_FAILURE;
+				}
+				break;
+
+			case 'f':
+				path = optarg;
+				break;
+
+			case 'c':
+				server_common.cachePages = strtoul(optarg, NULL, 0);
+				break;
+
+			case 'w':
+				server_common.wbTimeout = strtoul(optarg, NULL, 0) * 1000;
+				break;
+
+			case 'P':
+				depth = strtoul(optarg, NULL, 0);
+				if (depth == 0) {
+					fprintf(stderr, "serverdemo: invalid scheduling depth\n");
+					return EXIT_FAILURE;
+				}
+				break;
+
+			case 'A':
+				watermark = strtoul(optarg, NULL, 0);
+				if (watermark == 0) {
+					fprintf(stderr, "serverdemo: invalid admission watermark\n");
+					return EXIT_FAILURE;
+				}
+				break;
+
+			case 'T':
+				trace = 1;
+				break;
+
+			case 'B':
+				bench = strtoul(optarg, NULL, 0);
+				break;
+
+			case 'h':
+				server_usage(argv[0]);
+				return EXIT_SUCCESS;
+
+			default:
+				server_usage(argv[0]);
+				return EXIT_FAILURE;
+		}
+	}
+
+	if (server_common.nobjs == 0) {
+		server_common.nobjs = 1;
+	}
+
+	server_common.store.fd = -1;
+	if ((path != NULL) || (size != 0)) {
+		err = store_init(&server_common.store, path, (path != NULL) ? 0 : size * server_common.nobjs);
+		if (err < 0) {
+			fprintf(stderr, "serverdemo: failed to create backing store (%s)\n", strerror(-err));
+			return EXIT_FAILURE;
+		}
+
+		if (server_common.store.size < server_common.nobjs) {
+			fprintf(stderr, "serverdemo: backing store too small\n");
+			return EXIT_FAILURE;
+		}
+	}
+	else {
+		server_common.cachePages = 0;
+	}
+
+	if ((server_common.cachePages != 0) && (cache_init(&server_common.cache, &server_common.store, server_common.cachePages) < 0)) {
+		fprintf(stderr, "serverdemo: failed to create page cache\n");
+		return EXIT_FAILURE;
+	}
+
+	if ((server_common.wbTimeout != 0) && (wb_init(server_storeWrite, server_common.wbTimeout) < 0)) {
+		fprintf(stderr, "serverdemo: failed to start write-back thread\n");
+		return EXIT_FAILURE;
+	}
+
+	/* Create the port, the server framework handles messages received on it */
+	if (srv_init(&server_common.srv, server_common.nobjs + 2) < 0) {
+		fprintf(stderr, "serverdemo: srv_init failed\n");
+		return EXIT_FAILURE;
+	}
+
+	server_common.objs = calloc(server_common.nobjs, sizeof(server_obj_t));
+	if (server_common.objs == NULL) {
+		fprintf(stderr, "serverdemo: out of memory\n");
+		return EXIT_FAILURE;
+	}
+
+	if ((mutexCreate(&server_common.shmLock) < 0) || (srv_register(&server_common.srv, mtDevCtl, server_handleDevCtl) < 0)) {
+		fprintf(stderr, "serverdemo: failed to set up shared memory transfers\n");
+		return EXIT_FAILURE;
+	}
+
+	/* Every special file has its own id, the framework finds the object
+	 * addressed by the message oid in a hash table. */
+	for (i = 0; i < server_common.nobjs; ++i) {
+		if (mutexCreate(&server_common.objs[i].lock) < 0) {
+			fprintf(stderr, "serverdemo: mutexCreate failed\n");
+			return EXIT_FAILURE;
+		}
+
+		server_common.objs[i].file.id = i;
+		server_common.objs[i].file.size = server_common.store.size / server_common.nobjs;
+		server_common.objs[i].file.base = server_common.objs[i].file.size * i;
+		wb_bufInit(&server_common.objs[i].wb, server_common.objs[i].lock, &server_common.objs[i], server_common.objs[i].file.size);
+
+		if (srv_objAdd(&server_common.srv, &server_common.objs[i].obj, i, &server_ops) < 0) {
+			fprintf(stderr, "serverdemo: srv_objAdd failed\n");
+			return EXIT_FAILURE;
+		}
+	}
+
+	/* The FIFO follows the regular objects */
+	if ((mutexCreate(&server_common.fifo.lock) < 0) ||
+			(srv_objAdd(&server_common.srv, &server_common.fifo.obj, server_common.nobjs, &server_fifoOps) < 0)) {
+		fprintf(stderr, "serverdemo: failed to create FIFO\n");
+		return EXIT_FAILURE;
+	}
+	srv_objEvents(&server_common.fifo.obj, POLLOUT, POLLIN);
+
+	/* A single thread receives, -t threads handle requests by class */
+	if ((depth != 0) && (srv_schedule(&server_common.srv, depth, server_classify) < 0)) {
+		fprintf(stderr, "serverdemo: failed to enable scheduling\n");
+		return EXIT_FAILURE;
+	}
+
+	/* Overload is shed with -EAGAIN instead of queueing up in the kernel */
+	if ((watermark != 0) && (srv_admission(&server_common.srv, watermark) < 0)) {
+		fprintf(stderr, "serverdemo: admission control requires scheduling (-P)\n");
+		return EXIT_FAILURE;
+	}
+
+	/* Tracing takes a few timestamps per request, it's off by default */
+	if ((trace != 0) && (srv_trace(&server_common.srv) < 0)) {
+		fprintf(stderr, "serverdemo: failed to enable tracing\n");
+		return EXIT_FAILURE;
+	}
+
+	if ((trace != 0) || (watermark != 0)) {
+		server_common.stats.buf = malloc(SERVER_STATS_SIZE);
+		if ((server_common.stats.buf == NULL) || (mutexCreate(&server_common.stats.lock) < 0) ||
+				(srv_objAdd(&server_common.srv, &server_common.stats.obj, server_common.nobjs + 1, &server_statsOps) < 0)) {
+			fprintf(stderr, "serverdemo: failed to create statistics file\n");
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (bench != 0) {
+		server_benchDispatch(bench);
+		server_benchLookup(bench);
+		return EXIT_SUCCESS;
+	}
+
+	/* Printing is done by a low priority thread, outside of the request path. */
+	if (alog_init(verbosity, sample) < 0) {
+		fprintf(stderr, "serverdemo: failed to start log thread\n");
 		return EXIT_FAILURE;
 	}
 
@@ -175,14 +1017,40 @@ int main(void)
 	 * other processes to find out its value and to communicate with us.
 	 * We use create_dev() to do this. This function creates a special
 	 * file in the /dev directory and registers oid to it. This file can
-	 * be later used by the user to communicate with the server. */
-	if (create_dev(&oid, "serverdemo") < 0) {
-		fprintf(stderr, "serverdemo: create_dev failed\n");
+	 * be later used by the user to communicate with the server.
+	 * With more objects, object i is served as /dev/serverdemo<i>. */
+	oid.port = server_common.srv.port;
+	for (i = 0; i < server_common.nobjs; ++i) {
+		oid.id = i;
+		if (server_common.nobjs == 1) {
+			strcpy(name, "serverdemo");
+		}
+		else {
+			snprintf(name, sizeof(name), "serverdemo%u", i);
+		}
+
+		if (create_dev(&oid, name) < 0) {
+			fprintf(stderr, "serverdemo: create_dev %s failed\n", name);
+			return EXIT_FAILURE;
+		}
+	}
+
+	oid.id = server_common.fifo.obj.id;
+	if (create_dev(&oid, "serverdemo-fifo") < 0) {
+		fprintf(stderr, "serverdemo: create_dev serverdemo-fifo failed\n");
 		return EXIT_FAILURE;
 	}
 
+	if ((trace != 0) || (watermark != 0)) {
+		oid.id = server_common.stats.obj.id;
+		if (create_dev(&oid, "serverdemo-stats") < 0) {
+			fprintf(stderr, "serverdemo: create_dev serverdemo-stats failed\n");
+			return EXIT_FAILURE;
+		}
+	}
+
 	/* We're ready, start receiving and handling messages. */
-	server_msgLoop(&oid);
+	srv_run(&server_common.srv, nthreads);
 
 	/* Never reached */
 	return EXIT_FAILURE;
@@ -0,0 +1,110 @@
+/*
+ * Phoenix-RTOS
+ *
+ * Server demo
+ *
+ * Object table - open addressing hash map from object id to object
+ *
+ * Copyright 2026 Phoenix Systems
+ *
+ * This file is part of Phoenix-RTOS.
+ *
+ * %LICENSE%
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+
+#include "objtab.h"
+
+
+static void objtab_insert(objtab_t *tab, id_t id, void *obj)
+{
+	size_t i = objtab_hash(tab, id);
+
+	while (tab->entries[i].obj != NULL) {
+		i = (i + 1) & tab->mask;
+	}
+
+	tab->entries[i].id = id;
+	tab->entries[i].obj = obj;
+	tab->count++;
+}
+
+
+static int objtab_alloc(objtab_t *tab, size_t n)
+{
+	size_t size = 8;
+
+	/* Keep load factor below 1/2, probe sequences stay short */
+	while (size < 2 * n) {
+		size <<= 1;
+	}
+
+	tab->entries = calloc(size, sizeof(objtab_entry_t));
+	if (tab->entries == NULL) {
+		return -ENOMEM;
+	}
+
+	tab->mask = size - 1;
+	tab->count = 0;
+
+	return 0;
+}
+
+
+static int objtab_grow(objtab_t *tab)
+{
+	objtab_t old = *tab;
+	size_t i;
+
+	if (objtab_alloc(tab, old.mask + 1) < 0) {
+		*tab = old;
+		return -ENOMEM;
+	}
+
+	for (i = 0; i <= old.mask; ++i) {
+		if (old.entries[i].obj != NULL) {
+			objtab_insert(tab, old.entries[i].id, old.entries[i].obj);
+		}
+	}
+
+	free(old.entries);
+
+	return 0;
+}
+
+
+int objtab_add(objtab_t *tab, id_t id, void *obj)
+{
+	if (obj == NULL) {
+		return -EINVAL;
+	}
+
+	if (objtab_get(tab, id) != NULL) {
+		return -EEXIST;
+	}
+
+	if ((2 * (tab->count + 1) > tab->mask + 1) && (objtab_grow(tab) < 0)) {
+		return -ENOMEM;
+	}
+
+	objtab_insert(tab, id, obj);
+
+	return 0;
+}
+
+
+void objtab_done(objtab_t *tab)
+{
+	free(tab->entries);
+	tab->entries = NULL;
+	tab->mask = 0;
+	tab->count = 0;
+}
+
+
+int objtab_init(objtab_t *tab, size_t n)
+{
+	return objtab_alloc(tab, n);
+}
@@ -0,0 +1,71 @@
+/*
+ * Phoenix-RTOS
+ *
+ * Server demo
+ *
+ * Object table - open addressing hash map from object id to object
+ *
+ * Copyright 2026 Phoenix Systems
+ *
+ * This file is part of Phoenix-RTOS.
+ *
+ * %LICENSE%
+ */
+
+#ifndef _SERVERDEMO_OBJTAB_H_
+#define _SERVERDEMO_OBJTAB_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+
+typedef struct {
+	id_t id;
+	void *obj; /* NULL - empty entry */
+} objtab_entry_t;
+
+
+typedef struct {
+	objtab_entry_t *entries;
+	size_t mask; /* Capacity - 1, capacity is a power of 2 */
+	size_t count;
+} objtab_t;
+
+
+static inline size_t objtab_hash(const objtab_t *tab, id_t id)
+{
+	uint64_t h = (uint64_t)id * 0x9e3779b97f4a7c15ULL;
+
+	return (size_t)(h ^ (h >> 32)) & tab->mask;
+}
+
+
+/* Lookup is lock-free, but must not run concurrently with objtab_add() */
+static inline void *objtab_get(const objtab_t *tab, id_t id)
+{
+	size_t i = objtab_hash(tab, id);
+
+	/* Linear probing, the table is never more than half full */
+	while (tab->entries[i].obj != NULL) {
+		if (tab->entries[i].id == id) {
+			return tab->entries[i].obj;
+		}
+		i = (i + 1) & tab->mask;
+	}
+
+	return NULL;
+}
+
+
+extern int objtab_add(objtab_t *tab, id_t id, void *obj);
+
+
+extern void objtab_done(objtab_t *tab);
+
+
+/* Creates table with space for at least n objects before it needs to grow */
+extern int objtab_init(objtab_t *tab, size_t n);
+
+
+#endif
@@ -0,0 +1,260 @@
+/*
+ * Phoenix-RTOS
+ *
+ * Server demo
+ *
+ * Server framework - priority classes of pending requests
+ *
+ * The receiving thread takes requests off the port as they come and sorts
+ * them into classes, workers handle the highest class waiting. Bulk
+ * transfers can't take all workers, so control requests don't wait behind
+ * long writes, and a class passed over SCHED_BURST times in a row gets
+ * the next worker, so bulk transfers aren't starved either.
+ *
+ * With admission control bulk requests are rejected once the watermark of
+ * waiting requests is reached or depth of them are in flight, so an
+ * overload shows up as -EAGAIN to clients instead of a growing kernel
+ * queue. Control and normal requests are never rejected, the last entry
+ * of the pool is kept for control ones.
+ *
+ * Copyright 2026 Phoenix Systems
+ *
+ * This file is part of Phoenix-RTOS.
+ *
+ * %LICENSE%
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+#include <sys/threads.h>
+
+#include "sched.h"
+
+
+/* Takes a free entry, called with the lock held */
+static srv_req_t *sched_take(sched_t *sched, int control)
+{
+	srv_req_t *req;
+
+	if (sched->nfree <= ((control != 0) ? 0 : sched->reserve)) {
+		return NULL;
+	}
+
+	req = sched->free;
+	sched->free = req->next;
+	sched->nfree--;
+
+	return req;
+}
+
+
+srv_req_t *sched_alloc(sched_t *sched, int control)
+{
+	srv_req_t *req;
+
+	mutexLock(sched->lock);
+	while ((req = sched_take(sched, control)) == NULL) {
+		condWait(sched->freeCond, sched->lock, 0);
+	}
+	mutexUnlock(sched->lock);
+
+	return req;
+}
+
+
+srv_req_t *sched_tryAlloc(sched_t *sched)
+{
+	srv_req_t *req;
+
+	mutexLock(sched->lock);
+	req = sched_take(sched, 0);
+	mutexUnlock(sched->lock);
+
+	return req;
+}
+
+
+static void sched_release(sched_t *sched, srv_req_t *req)
+{
+	req->next = sched->free;
+	sched->free = req;
+	sched->nfree++;
+	condSignal(sched->freeCond);
+}
+
+
+void sched_free(sched_t *sched, srv_req_t *req)
+{
+	mutexLock(sched->lock);
+	sched_release(sched, req);
+	mutexUnlock(sched->lock);
+}
+
+
+int sched_put(sched_t *sched, srv_req_t *req)
+{
+	mutexLock(sched->lock);
+	if ((sched->watermark != 0) && (sched->queued >= sched->watermark) && (req->sclass == srvClassBulk)) {
+		mutexUnlock(sched->lock);
+		sched_reject(sched, req->sclass);
+		return -EAGAIN;
+	}
+
+	sched->queued++;
+	req->next = NULL;
+	if (sched->classes[req->sclass].tail != NULL) {
+		sched->classes[req->sclass].tail->next = req;
+	}
+	else {
+		sched->classes[req->sclass].head = req;
+	}
+	sched->classes[req->sclass].tail = req;
+	condSignal(sched->cond);
+	mutexUnlock(sched->lock);
+
+	return 0;
+}
+
+
+/* Returns the class to serve next, -1 if none can be served now */
+static int sched_pick(sched_t *sched)
+{
+	int c, pick = -1, lower = -1;
+
+	for (c = 0; c < srvClasses; ++c) {
+		if ((sched->classes[c].head == NULL) || (sched->classes[c].running >= sched->classes[c].limit)) {
+			continue;
+		}
+
+		if (pick < 0) {
+			pick = c;
+		}
+		else {
+			lower = c;
+			break;
+		}
+	}
+
+	if (lower < 0) {
+		sched->skipped = 0;
+		return pick;
+	}
+
+	if (++sched->skipped > SCHED_BURST) {
+		sched->skipped = 0;
+		return lower;
+	}
+
+	return pick;
+}
+
+
+srv_req_t *sched_get(sched_t *sched)
+{
+	srv_req_t *req;
+	int c;
+
+	mutexLock(sched->lock);
+	for (;;) {
+		c = sched_pick(sched);
+		if (c >= 0) {
+			break;
+		}
+		condWait(sched->cond, sched->lock, 0);
+	}
+
+	req = sched->classes[c].head;
+	sched->classes[c].head = req->next;
+	if (sched->classes[c].head == NULL) {
+		sched->classes[c].tail = NULL;
+	}
+	sched->classes[c].running++;
+	sched->queued--;
+	mutexUnlock(sched->lock);
+
+	return req;
+}
+
+
+void sched_done(sched_t *sched, srv_req_t *req)
+{
+	mutexLock(sched->lock);
+	sched->classes[req->sclass].running--;
+	sched_release(sched, req);
+
+	/* A worker may be waiting for the class limit */
+	if (sched->classes[req->sclass].head != NULL) {
+		condSignal(sched->cond);
+	}
+	mutexUnlock(sched->lock);
+}
+
+
+void sched_limit(sched_t *sched, unsigned int nworkers)
+{
+	unsigned int i;
+
+	mutexLock(sched->lock);
+	for (i = 0; i < srvClasses; ++i) {
+		sched->classes[i].limit = nworkers;
+	}
+	if (nworkers > 1) {
+		sched->classes[srvClassBulk].limit = nworkers - 1;
+	}
+	condBroadcast(sched->cond);
+	mutexUnlock(sched->lock);
+}
+
+
+int sched_init(sched_t *sched, unsigned int depth)
+{
+	unsigned int i;
+	int err;
+
+	sched->pool = calloc(depth, sizeof(srv_req_t));
+	if (sched->pool == NULL) {
+		return -ENOMEM;
+	}
+
+	err = mutexCreate(&sched->lock);
+	if (err < 0) {
+		free(sched->pool);
+		return err;
+	}
+
+	err = condCreate(&sched->cond);
+	if (err < 0) {
+		resourceDestroy(sched->lock);
+		free(sched->pool);
+		return err;
+	}
+
+	err = condCreate(&sched->freeCond);
+	if (err < 0) {
+		resourceDestroy(sched->cond);
+		resourceDestroy(sched->lock);
+		free(sched->pool);
+		return err;
+	}
+
+	sched->free = NULL;
+	sched->nfree = depth;
+	sched->reserve = 0;
+	for (i = 0; i < depth; ++i) {
+		sched->pool[i].next = sched->free;
+		sched->free = &sched->pool[i];
+	}
+
+	sched->skipped = 0;
+	sched->queued = 0;
+	sched->watermark = 0;
+	for (i = 0; i < srvClasses; ++i) {
+		atomic_init(&sched->rejected[i], 0);
+		sched->classes[i].head = NULL;
+		sched->classes[i].tail = NULL;
+		sched->classes[i].running = 0;
+		sched->classes[i].limit = 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,92 @@
+/*
+ * Phoenix-RTOS
+ *
+ * Server demo
+ *
+ * Server framework - priority classes of pending requests
+ *
+ * Copyright 2026 Phoenix Systems
+ *
+ * This file is part of Phoenix-RTOS.
+ *
+ * %LICENSE%
+ */
+
+#ifndef _SERVERDEMO_SCHED_H_
+#define _SERVERDEMO_SCHED_H_
+
+#include <stdatomic.h>
+
+#include "srv.h"
+
+
+/* Consecutive picks of a higher class after which a waiting lower class gets its turn */
+#define SCHED_BURST 8
+
+
+struct _sched_t {
+	handle_t lock;
+	handle_t cond;     /* Request queued or a class slot freed */
+	handle_t freeCond; /* Entry returned to the pool */
+	srv_req_t *free;
+	srv_req_t *pool;
+	unsigned int nfree;
+	unsigned int reserve; /* Free entries only control requests may take */
+	unsigned int skipped;
+	unsigned int queued;
+	unsigned int watermark; /* 0 - admit everything */
+	atomic_ulong rejected[srvClasses];
+
+	struct {
+		srv_req_t *head;
+		srv_req_t *tail;
+		unsigned int running;
+		unsigned int limit; /* Workers the class may occupy at once */
+	} classes[srvClasses];
+};
+
+
+/* Takes a free request entry, waits if all depth entries are in use.
+ * Only control requests may take the reserved entries. */
+extern srv_req_t *sched_alloc(sched_t *sched, int control);
+
+
+/* Takes a free request entry for a request of any class, NULL if only
+ * the reserved ones are left */
+extern srv_req_t *sched_tryAlloc(sched_t *sched);
+
+
+/* Returns an entry which wasn't queued to the pool */
+extern void sched_free(sched_t *sched, srv_req_t *req);
+
+
+/* Queues a received request in its class (req->sclass). With watermark
+ * or more requests waiting, bulk ones are rejected (and counted) with -EAGAIN. */
+extern int sched_put(sched_t *sched, srv_req_t *req);
+
+
+/* Counts a request rejected by the caller */
+static inline void sched_reject(sched_t *sched, int sclass)
+{
+	atomic_fetch_add_explicit(&sched->rejected[sclass], 1, memory_order_relaxed);
+}
+
+
+/* Waits for the next request to handle, the highest class first */
+extern srv_req_t *sched_get(sched_t *sched);
+
+
+/* Ends handling of a request taken with sched_get() and frees its entry */
+extern void sched_done(sched_t *sched, srv_req_t *req);
+
+
+/* Sets the number of workers. Bulk requests are limited to nworkers - 1
+ * of them, one is always left for the other classes. */
+extern void sched_limit(sched_t *sched, unsigned int nworkers);
+
+
+/* Allocates depth request entries, starts with a single worker */
+extern int sched_init(sched_t *sched, unsigned int depth);
+
+
+#endif
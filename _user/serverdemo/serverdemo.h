@@ -0,0 +1,84 @@
+/*
+ * Phoenix-RTOS
+ *
+ * Server demo
+ *
+ * Interface of the server demo for its clients
+ *
+ * Copyright 2026 Phoenix Systems
+ *
+ * This file is part of Phoenix-RTOS.
+ *
+ * %LICENSE%
+ */
+
+#ifndef _SERVERDEMO_H_
+#define _SERVERDEMO_H_
+
+#include <sys/types.h>
+#include <sys/mman.h>
+
+
+#define SERVERDEMO_SHM_MAX  (4 * 1024 * 1024)
+#define SERVERDEMO_SEGS_MAX 1024
+
+
+/* mtDevCtl requests, passed in msg.i.raw */
+enum {
+	/* Allocates a shared memory region. The client maps it with
+	 * mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS | MAP_PHYSMEM, -1, paddr) */
+	serverdemo_shmMap = 1,
+	/* Frees the region */
+	serverdemo_shmUnmap,
+	/* Reads object data at offs into the region at shmOffs */
+	serverdemo_shmRead,
+	/* Writes data from the region at shmOffs to the object at offs */
+	serverdemo_shmWrite,
+	/* Reads the segments listed in msg.i.data into msg.o.data, back to back */
+	serverdemo_readv,
+	/* Writes the data following the segment list in msg.i.data to the segments */
+	serverdemo_writev,
+};
+
+
+/* Segment of a vectored request */
+typedef struct {
+	off_t offs;
+	size_t len;
+} serverdemo_seg_t;
+
+
+typedef struct {
+	int type;
+	unsigned int region;
+	union {
+		/* serverdemo_shmMap */
+		struct {
+			size_t size;
+		} map;
+
+		/* serverdemo_shmRead, serverdemo_shmWrite */
+		struct {
+			off_t offs;
+			size_t shmOffs;
+			size_t len;
+		} io;
+
+		/* serverdemo_readv, serverdemo_writev */
+		struct {
+			unsigned int nsegs;
+		} vec;
+	};
+} serverdemo_devctl_t;
+
+
+/* Response in msg.o.raw, msg.o.err is the result (length transferred for io requests) */
+typedef struct {
+	/* serverdemo_shmMap */
+	unsigned int region;
+	addr_t paddr;
+	size_t size;
+} serverdemo_devctlo_t;
+
+
+#endif
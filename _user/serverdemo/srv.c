@@ -0,0 +1,615 @@
+/*
+ * Phoenix-RTOS
+ *
+ * Server demo
+ *
+ * Server framework - message loop and dispatch
+ *
+ * Copyright 2026 Phoenix Systems
+ *
+ * This file is part of Phoenix-RTOS.
+ *
+ * %LICENSE%
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/threads.h>
+
+#include "sched.h"
+#include "srv.h"
+
+
+#define SRV_PRIO    4
+#define SRV_STACKSZ 4096
+
+
+static int srv_handleOpen(srv_t *srv, srv_req_t *req)
+{
+	if ((req->obj == NULL) || (req->obj->ops->open == NULL)) {
+		/* Objects without open handler allow open() on them */
+		return (req->obj == NULL) ? -ENOENT : 0;
+	}
+
+	return req->obj->ops->open(req->obj, req->msg.i.openclose.flags);
+}
+
+
+static int srv_handleClose(srv_t *srv, srv_req_t *req)
+{
+	if ((req->obj == NULL) || (req->obj->ops->close == NULL)) {
+		return (req->obj == NULL) ? -ENOENT : 0;
+	}
+
+	return req->obj->ops->close(req->obj);
+}
+
+
+static int srv_handleRead(srv_t *srv, srv_req_t *req)
+{
+	if ((req->obj == NULL) || (req->obj->ops->read == NULL)) {
+		return (req->obj == NULL) ? -ENOENT : -ENOSYS;
+	}
+
+	/* Buffer in msg.o.data is provided by the user and
+	 * was allocated in the server memory space by the kernel. */
+	return req->obj->ops->read(req->obj, req->msg.o.data, req->msg.o.size, req->msg.i.io.offs);
+}
+
+
+static int srv_handleWrite(srv_t *srv, srv_req_t *req)
+{
+	if ((req->obj == NULL) || (req->obj->ops->write == NULL)) {
+		return (req->obj == NULL) ? -ENOENT : -ENOSYS;
+	}
+
+	/* Buffer in msg.i.data is provided by the user and
+	 * was allocated in the server memory space by the kernel. */
+	return req->obj->ops->write(req->obj, req->msg.i.data, req->msg.i.size, req->msg.i.io.offs);
+}
+
+
+static int srv_handleSync(srv_t *srv, srv_req_t *req)
+{
+	if ((req->obj == NULL) || (req->obj->ops->sync == NULL)) {
+		/* Nothing to sync */
+		return (req->obj == NULL) ? -ENOENT : 0;
+	}
+
+	return req->obj->ops->sync(req->obj);
+}
+
+
+static int srv_handleGetAttr(srv_t *srv, srv_req_t *req)
+{
+	long long val;
+	int err;
+
+	if (req->obj == NULL) {
+		return -ENOENT;
+	}
+
+	/* poll() asks for the object readiness */
+	if (req->msg.i.attr.type == atPollStatus) {
+		req->msg.o.attr.val = atomic_load_explicit(&req->obj->events, memory_order_acquire);
+		return 0;
+	}
+
+	if (req->obj->ops->getattr == NULL) {
+		return -EINVAL;
+	}
+
+	err = req->obj->ops->getattr(req->obj, req->msg.i.attr.type, &val);
+	if (err == 0) {
+		req->msg.o.attr.val = val;
+	}
+
+	return err;
+}
+
+
+/* Default handlers, all other types are not supported */
+static const srv_handler_t srv_defaults[SRV_TYPES] = {
+	[mtOpen] = srv_handleOpen,
+	[mtClose] = srv_handleClose,
+	[mtRead] = srv_handleRead,
+	[mtWrite] = srv_handleWrite,
+	[mtGetAttr] = srv_handleGetAttr,
+};
+
+
+static int srv_call(srv_t *srv, srv_req_t *req)
+{
+	msg_t *msg = &req->msg;
+	srv_handler_t handler = NULL;
+	unsigned int i;
+
+	/* Hot path: data transfer goes straight to the object */
+	if ((msg->type == mtRead) && (req->obj != NULL) && (req->obj->ops->read != NULL) && (srv->handlers[mtRead] == srv_handleRead)) {
+		return req->obj->ops->read(req->obj, msg->o.data, msg->o.size, msg->i.io.offs);
+	}
+
+	if ((msg->type == mtWrite) && (req->obj != NULL) && (req->obj->ops->write != NULL) && (srv->handlers[mtWrite] == srv_handleWrite)) {
+		return req->obj->ops->write(req->obj, msg->i.data, msg->i.size, msg->i.io.offs);
+	}
+
+	if ((msg->type >= 0) && (msg->type < SRV_TYPES)) {
+		handler = srv->handlers[msg->type];
+	}
+	else {
+		for (i = 0; i < SRV_XTYPES; ++i) {
+			if ((srv->xhandlers[i].handler != NULL) && (srv->xhandlers[i].type == msg->type)) {
+				handler = srv->xhandlers[i].handler;
+				break;
+			}
+		}
+	}
+
+	return (handler != NULL) ? handler(srv, req) : -ENOSYS;
+}
+
+
+/* Calls the handler, parks the request if it has to wait. The request is
+ * queued at the tail, or at the head followed by the rest list if it's
+ * a parked one. Returns 0 if the response is ready, SRV_DEFERRED if the
+ * request is parked. */
+static int srv_execute(srv_t *srv, srv_req_t *req, int parked, srv_req_t *rest, srv_req_t *restTail)
+{
+	srv_obj_t *obj = req->obj;
+	srv_req_t *p;
+	unsigned int wseq;
+	int err;
+
+	for (;;) {
+		wseq = (obj != NULL) ? atomic_load_explicit(&obj->wseq, memory_order_acquire) : 0;
+
+		if (srv->trace != 0) {
+			req->ts.start = trace_now();
+		}
+		err = srv_call(srv, req);
+		if (srv->trace != 0) {
+			req->ts.end = trace_now();
+		}
+		if (err != SRV_DEFERRED) {
+			req->msg.o.err = err;
+			return 0;
+		}
+
+		/* Non-blocking callers poll() for the object readiness instead */
+		if ((obj == NULL) || (((req->msg.type == mtRead) || (req->msg.type == mtWrite)) && ((req->msg.i.io.mode & O_NONBLOCK) != 0))) {
+			req->msg.o.err = -EAGAIN;
+			return 0;
+		}
+
+		p = req;
+		if (parked == 0) {
+			/* The request lives on the receiving thread stack */
+			p = malloc(sizeof(*p));
+			if (p == NULL) {
+				req->msg.o.err = -ENOMEM;
+				return 0;
+			}
+			*p = *req;
+		}
+
+		mutexLock(srv->waitLock);
+		if (atomic_load_explicit(&obj->wseq, memory_order_relaxed) == wseq) {
+			break;
+		}
+		mutexUnlock(srv->waitLock);
+
+		/* The object was woken up while the request was handled, retry */
+		if (p != req) {
+			free(p);
+		}
+	}
+
+	if (parked == 0) {
+		p->next = NULL;
+		if (obj->waitqTail != NULL) {
+			obj->waitqTail->next = p;
+		}
+		else {
+			obj->waitq = p;
+		}
+		obj->waitqTail = p;
+	}
+	else {
+		p->next = rest;
+		if (rest == NULL) {
+			restTail = p;
+		}
+		if (obj->waitq == NULL) {
+			obj->waitqTail = restTail;
+		}
+		restTail->next = obj->waitq;
+		obj->waitq = p;
+	}
+	mutexUnlock(srv->waitLock);
+
+	return SRV_DEFERRED;
+}
+
+
+int srv_dispatch(srv_t *srv, srv_req_t *req)
+{
+	req->obj = srv_objGet(srv, req->msg.oid.id);
+
+	return srv_execute(srv, req, 0, NULL, NULL);
+}
+
+
+void srv_wakeup(srv_t *srv, srv_obj_t *obj)
+{
+	srv_req_t *list, *tail, *req;
+
+	mutexLock(srv->waitLock);
+	atomic_fetch_add_explicit(&obj->wseq, 1, memory_order_release);
+	list = obj->waitq;
+	tail = obj->waitqTail;
+	obj->waitq = NULL;
+	obj->waitqTail = NULL;
+	mutexUnlock(srv->waitLock);
+
+	while (list != NULL) {
+		req = list;
+		list = list->next;
+
+		if (srv_execute(srv, req, 1, list, tail) != 0) {
+			/* Has to wait again, the rest went back to the queue with it */
+			break;
+		}
+
+		/* The buffers of a parked request stay mapped until the response */
+		msgRespond(srv->port, &req->msg, req->rid);
+		if (srv->trace != 0) {
+			/* Not necessarily a receiving thread, use the shared ring */
+			trace_record(NULL, req->msg.type, &req->ts);
+		}
+		free(req);
+	}
+}
+
+
+/* Receives the next message into the request */
+static void srv_receive(srv_t *srv, srv_req_t *req)
+{
+	int err;
+
+	for (;;) {
+		/* Receive the next message. This call will block until a message
+		 * becomes available. It can be interrupted by a posix signal. */
+		err = msgRecv(srv->port, &req->msg, &req->rid);
+		if (err == 0) {
+			break;
+		}
+
+		if (err != -EINTR) {
+			/* Some serious error occurred. We end the server
+			 * process as we're unable to process messages. */
+			fprintf(stderr, "srv: msgRecv returned %d (%s)\n", err, strerror(-err));
+			exit(EXIT_FAILURE);
+		}
+
+		/* We were interrupted by a posix signal. So we
+		 * just try again to receive a valid message. */
+	}
+
+	if (srv->trace != 0) {
+		req->ts.recv = trace_now();
+	}
+}
+
+
+/* Handles a received request and responds to it unless it was parked */
+static void srv_complete(srv_t *srv, srv_req_t *req, trace_ring_t *ring)
+{
+	if (srv_dispatch(srv, req) == SRV_DEFERRED) {
+		/* The request waits for an event, the response will
+		 * be sent when it completes. We can take the next
+		 * message meanwhile. */
+		return;
+	}
+
+	/* Now we respond to the message we just handled.
+	 * We pass the message that we received (modified by
+	 * processing it) back to the kernel, along with the
+	 * respond ID that we received from msgRecv(). */
+	msgRespond(srv->port, &req->msg, req->rid);
+
+	if (srv->trace != 0) {
+		trace_record(ring, req->msg.type, &req->ts);
+	}
+}
+
+
+static __attribute__((noreturn)) void srv_msgLoop(srv_t *srv)
+{
+	/* The request holds the message structure filled-in by kernel during
+	 * msgRecv() syscall and the message response ID. The ID allows the
+	 * kernel to distinguish between messages passed to the server when
+	 * the server is responding. It is needed, because the server might be
+	 * handling more than one message in parallel at any given time, so
+	 * the kernel needs an information, to which user the server it
+	 * responding. It also lets several server threads receive from the
+	 * same port at once, each of them running this loop. */
+	srv_req_t req;
+	trace_ring_t *ring = (srv->trace != 0) ? trace_ringAlloc() : NULL;
+
+	for (;;) {
+		srv_receive(srv, &req);
+		srv_complete(srv, &req, ring);
+	}
+}
+
+
+static void srv_msgThread(void *arg)
+{
+	srv_msgLoop(arg);
+}
+
+
+/* With scheduling, the receiver only sorts requests into classes. The
+ * response ID keeps them apart while they wait for a worker. */
+static __attribute__((noreturn)) void srv_recvLoop(srv_t *srv)
+{
+	srv_req_t *req, spare;
+
+	for (;;) {
+		if (srv->admission == 0) {
+			/* Stops receiving while depth requests are in
+			 * flight, the rest queues up in the kernel */
+			req = sched_alloc(srv->sched, 0);
+		}
+		else {
+			req = sched_tryAlloc(srv->sched);
+			if (req == NULL) {
+				/* Over the limit, receive to find out the class */
+				req = &spare;
+			}
+		}
+		srv_receive(srv, req);
+
+		req->sclass = srv->classify(&req->msg);
+		if ((req->sclass < 0) || (req->sclass >= srvClasses)) {
+			req->sclass = srvClassNormal;
+		}
+
+		if ((req == &spare) && (req->sclass != srvClassBulk)) {
+			/* Only bulk requests are shed, the others wait for an entry.
+			 * Control ones can take the reserved entry, so a close isn't
+			 * lost even with all other entries held by bulk transfers. */
+			req = sched_alloc(srv->sched, req->sclass == srvClassControl);
+			*req = spare;
+		}
+
+		if (req != &spare) {
+			if (sched_put(srv->sched, req) == 0) {
+				continue;
+			}
+		}
+		else {
+			sched_reject(srv->sched, req->sclass);
+		}
+
+		/* Shed the request, the client may retry later */
+		req->msg.o.err = -EAGAIN;
+		msgRespond(srv->port, &req->msg, req->rid);
+		if (req != &spare) {
+			sched_free(srv->sched, req);
+		}
+	}
+}
+
+
+static void srv_workThread(void *arg)
+{
+	srv_t *srv = arg;
+	trace_ring_t *ring = (srv->trace != 0) ? trace_ringAlloc() : NULL;
+	srv_req_t *req;
+
+	for (;;) {
+		req = sched_get(srv->sched);
+
+		/* A parked request is copied, the entry can go back to the pool */
+		srv_complete(srv, req, ring);
+		sched_done(srv->sched, req);
+	}
+}
+
+
+int srv_classify(const msg_t *msg)
+{
+	int sclass = srvClassControl;
+
+	if (msg->type == mtRead) {
+		sclass = (msg->o.size >= SRV_BULK_SIZE) ? srvClassBulk : srvClassNormal;
+	}
+	else if (msg->type == mtWrite) {
+		sclass = (msg->i.size >= SRV_BULK_SIZE) ? srvClassBulk : srvClassNormal;
+	}
+
+	/* Lower value - higher priority */
+	if ((msg->priority < SRV_PRIO) && (sclass > srvClassControl)) {
+		sclass--;
+	}
+	else if ((msg->priority > SRV_PRIO) && (sclass < srvClassBulk)) {
+		sclass++;
+	}
+
+	return sclass;
+}
+
+
+int srv_schedule(srv_t *srv, unsigned int depth, srv_classifier_t classify)
+{
+	srv->sched = malloc(sizeof(*srv->sched));
+	if (srv->sched == NULL) {
+		return -ENOMEM;
+	}
+
+	/* The number of workers is set in srv_run() */
+	if (sched_init(srv->sched, depth) < 0) {
+		free(srv->sched);
+		srv->sched = NULL;
+		return -ENOMEM;
+	}
+	srv->classify = (classify != NULL) ? classify : srv_classify;
+
+	return 0;
+}
+
+
+int srv_admission(srv_t *srv, unsigned int watermark)
+{
+	if (srv->sched == NULL) {
+		return -EINVAL;
+	}
+
+	srv->sched->watermark = watermark;
+	srv->admission = 1;
+
+	/* The last entry is kept for control requests, unless it's the only one */
+	mutexLock(srv->sched->lock);
+	srv->sched->reserve = (srv->sched->nfree > 1) ? 1 : 0;
+	mutexUnlock(srv->sched->lock);
+
+	return 0;
+}
+
+
+unsigned long srv_rejected(srv_t *srv, int sclass)
+{
+	if ((srv->sched == NULL) || (sclass < 0) || (sclass >= srvClasses)) {
+		return 0;
+	}
+
+	return atomic_load_explicit(&srv->sched->rejected[sclass], memory_order_relaxed);
+}
+
+
+void srv_run(srv_t *srv, unsigned int nthreads)
+{
+	unsigned int i;
+
+	if (nthreads > SRV_THREADS_MAX) {
+		nthreads = SRV_THREADS_MAX;
+	}
+
+	if (srv->sched != NULL) {
+		for (i = 0; i < nthreads; ++i) {
+			srv->stacks[i] = malloc(SRV_STACKSZ);
+			if ((srv->stacks[i] == NULL) || (beginthread(srv_workThread, SRV_PRIO, srv->stacks[i], SRV_STACKSZ, srv) < 0)) {
+				free(srv->stacks[i]);
+				srv->stacks[i] = NULL;
+				break;
+			}
+		}
+
+		if (i == 0) {
+			fprintf(stderr, "srv: failed to start workers\n");
+			exit(EXIT_FAILURE);
+		}
+		if (i < nthreads) {
+			fprintf(stderr, "srv: failed to start worker %u, continuing with %u\n", i + 1, i);
+		}
+
+		sched_limit(srv->sched, i);
+		srv_recvLoop(srv);
+	}
+
+	/* All threads receive from the same port, the kernel hands each
+	 * message to exactly one of them. The caller is the last receiver. */
+	for (i = 0; i + 1 < nthreads; ++i) {
+		srv->stacks[i] = malloc(SRV_STACKSZ);
+		if ((srv->stacks[i] == NULL) || (beginthread(srv_msgThread, SRV_PRIO, srv->stacks[i], SRV_STACKSZ, srv) < 0)) {
+			fprintf(stderr, "srv: failed to start thread %u, continuing with %u\n", i + 1, i + 1);
+			free(srv->stacks[i]);
+			srv->stacks[i] = NULL;
+			break;
+		}
+	}
+
+	srv_msgLoop(srv);
+}
+
+
+int srv_objAdd(srv_t *srv, srv_obj_t *obj, id_t id, const srv_ops_t *ops)
+{
+	obj->id = id;
+	obj->ops = ops;
+	obj->waitq = NULL;
+	obj->waitqTail = NULL;
+	atomic_init(&obj->wseq, 0);
+	atomic_init(&obj->events, POLLIN | POLLOUT);
+
+	return objtab_add(&srv->objs, id, obj);
+}
+
+
+int srv_register(srv_t *srv, int type, srv_handler_t handler)
+{
+	unsigned int i;
+
+	if ((type >= 0) && (type < SRV_TYPES)) {
+		srv->handlers[type] = handler;
+		return 0;
+	}
+
+	for (i = 0; i < SRV_XTYPES; ++i) {
+		if ((srv->xhandlers[i].handler == NULL) || (srv->xhandlers[i].type == type)) {
+			srv->xhandlers[i].type = type;
+			srv->xhandlers[i].handler = handler;
+			return 0;
+		}
+	}
+
+	return -ENOSPC;
+}
+
+
+int srv_trace(srv_t *srv)
+{
+	int err = trace_init();
+
+	if (err == 0) {
+		srv->trace = 1;
+	}
+
+	return err;
+}
+
+
+int srv_init(srv_t *srv, size_t nobjs)
+{
+	int err;
+
+	memset(srv, 0, sizeof(*srv));
+	memcpy(srv->handlers, srv_defaults, sizeof(srv->handlers));
+
+	/* mtSync isn't necessarily in the table range */
+	srv_register(srv, mtSync, srv_handleSync);
+
+	err = mutexCreate(&srv->waitLock);
+	if (err < 0) {
+		return err;
+	}
+
+	err = objtab_init(&srv->objs, nobjs);
+	if (err < 0) {
+		resourceDestroy(srv->waitLock);
+		return err;
+	}
+
+	err = portCreate(&srv->port);
+	if (err < 0) {
+		objtab_done(&srv->objs);
+		resourceDestroy(srv->waitLock);
+	}
+
+	return err;
+}
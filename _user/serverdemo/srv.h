@@ -0,0 +1,182 @@
+/*
+ * Phoenix-RTOS
+ *
+ * Server demo
+ *
+ * Server framework - message loop and dispatch
+ *
+ * Copyright 2026 Phoenix Systems
+ *
+ * This file is part of Phoenix-RTOS.
+ *
+ * %LICENSE%
+ */
+
+#ifndef _SERVERDEMO_SRV_H_
+#define _SERVERDEMO_SRV_H_
+
+#include <limits.h>
+#include <stdatomic.h>
+#include <sys/types.h>
+#include <sys/msg.h>
+#include <sys/threads.h>
+
+#include "objtab.h"
+#include "trace.h"
+
+
+#define SRV_TYPES       mtCount /* Types dispatched by table lookup */
+#define SRV_XTYPES      4       /* Types registered outside of the table range */
+#define SRV_THREADS_MAX 16
+#define SRV_BULK_SIZE   4096
+
+/* Returned by a handler if the request can't complete yet. The request is
+ * parked on its object and handled again after srv_wakeup() on the object. */
+#define SRV_DEFERRED INT_MIN
+
+
+/* Scheduling classes, in order of precedence */
+enum { srvClassControl = 0, srvClassNormal, srvClassBulk, srvClasses };
+
+
+typedef struct _srv_t srv_t;
+typedef struct _srv_obj_t srv_obj_t;
+typedef struct _sched_t sched_t;
+
+
+/* Returns the scheduling class of a received message */
+typedef int (*srv_classifier_t)(const msg_t *msg);
+
+
+typedef struct _srv_req_t {
+	msg_t msg;
+	msg_rid_t rid;
+	srv_obj_t *obj; /* Object addressed by msg.oid, NULL if not registered */
+	struct _srv_req_t *next;
+	trace_stamps_t ts; /* Valid if tracing is enabled */
+	int sclass;        /* Valid if scheduling is enabled */
+} srv_req_t;
+
+
+/* Handles a request, the return value is passed to the client in msg.o.err */
+typedef int (*srv_handler_t)(srv_t *srv, srv_req_t *req);
+
+
+/* Per-object handlers of file operations, NULL if not supported */
+typedef struct {
+	int (*open)(srv_obj_t *obj, int flags);
+	int (*close)(srv_obj_t *obj);
+	ssize_t (*read)(srv_obj_t *obj, void *data, size_t len, off_t offs);
+	ssize_t (*write)(srv_obj_t *obj, const void *data, size_t len, off_t offs);
+	int (*sync)(srv_obj_t *obj);
+	int (*getattr)(srv_obj_t *obj, int type, long long *val); /* Other than atPollStatus */
+} srv_ops_t;
+
+
+struct _srv_obj_t {
+	id_t id;
+	const srv_ops_t *ops;
+
+	/* Parked requests, protected by the server wait lock */
+	srv_req_t *waitq;
+	srv_req_t *waitqTail;
+	atomic_uint wseq; /* Number of srv_wakeup() calls */
+
+	/* Readiness reported to poll() (POLLIN, POLLOUT, ...) */
+	atomic_uint events;
+};
+
+
+struct _srv_t {
+	uint32_t port;
+	srv_handler_t handlers[SRV_TYPES];
+	struct {
+		int type;
+		srv_handler_t handler;
+	} xhandlers[SRV_XTYPES];
+	objtab_t objs;
+	handle_t waitLock;
+	char *stacks[SRV_THREADS_MAX];
+	int trace;
+	sched_t *sched; /* NULL - threads handle messages as they receive them */
+	srv_classifier_t classify;
+	int admission;
+};
+
+
+/* Finds object by id, object lookup is lock-free */
+static inline srv_obj_t *srv_objGet(srv_t *srv, id_t id)
+{
+	return objtab_get(&srv->objs, id);
+}
+
+
+/* Sets and clears object readiness bits, returns the bits which became set.
+ * The caller should srv_wakeup() the object if it has requests waiting for them. */
+static inline unsigned int srv_objEvents(srv_obj_t *obj, unsigned int set, unsigned int clear)
+{
+	unsigned int old = atomic_load_explicit(&obj->events, memory_order_relaxed);
+
+	while (!atomic_compare_exchange_weak_explicit(&obj->events, &old, (old & ~clear) | set, memory_order_release, memory_order_relaxed)) {
+	}
+
+	return set & ~old;
+}
+
+
+/* Registers an object, has to be done before srv_run(). The object is
+ * ready for reading and writing until srv_objEvents() says otherwise. */
+extern int srv_objAdd(srv_t *srv, srv_obj_t *obj, id_t id, const srv_ops_t *ops);
+
+
+/* Registers a handler for a message type, replacing the default one */
+extern int srv_register(srv_t *srv, int type, srv_handler_t handler);
+
+
+/* Handles a request. Returns 0 if the response is ready in msg.o.err,
+ * SRV_DEFERRED if the request was parked - the framework responds later. */
+extern int srv_dispatch(srv_t *srv, srv_req_t *req);
+
+
+/* Handles again requests parked on the object, called by the event source
+ * after the object state changed. Parked requests are retried in order
+ * until one of them has to wait again. */
+extern void srv_wakeup(srv_t *srv, srv_obj_t *obj);
+
+
+/* Default classifier: data transfers of at least SRV_BULK_SIZE bytes are
+ * bulk, other transfers normal and all other messages control ones. Sender
+ * priority above or below the server's moves the message one class. */
+extern int srv_classify(const msg_t *msg);
+
+
+/* Enables scheduling by class, has to be done before srv_run(). Up to depth
+ * received messages wait for a worker, the receiver stops taking more. */
+extern int srv_schedule(srv_t *srv, unsigned int depth, srv_classifier_t classify);
+
+
+/* Enables admission control with scheduling: bulk requests over the depth
+ * limit or with watermark requests waiting get -EAGAIN at once. Control and
+ * normal requests wait for a free entry, one entry is reserved for control. */
+extern int srv_admission(srv_t *srv, unsigned int watermark);
+
+
+/* Returns the number of requests of a class rejected by admission control */
+extern unsigned long srv_rejected(srv_t *srv, int sclass);
+
+
+/* Receives and handles messages using nthreads threads (including the caller).
+ * With scheduling the caller receives and nthreads workers handle messages. */
+extern __attribute__((noreturn)) void srv_run(srv_t *srv, unsigned int nthreads);
+
+
+/* Enables per-request tracing (see trace.h), has to be done before srv_run() */
+extern int srv_trace(srv_t *srv);
+
+
+/* Creates the server port and installs the default handlers,
+ * nobjs is the expected number of objects */
+extern int srv_init(srv_t *srv, size_t nobjs);
+
+
+#endif
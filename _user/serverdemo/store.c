@@ -0,0 +1,124 @@
+/*
+ * Phoenix-RTOS
+ *
+ * Server demo
+ *
+ * Backing store - RAM or file
+ *
+ * Copyright 2026 Phoenix Systems
+ *
+ * This file is part of Phoenix-RTOS.
+ *
+ * %LICENSE%
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "store.h"
+
+
+ssize_t store_read(store_t *store, void *data, size_t len, off_t offs)
+{
+	ssize_t ret;
+
+	if (offs < 0) {
+		return -EINVAL;
+	}
+
+	if (offs >= store->size) {
+		return 0;
+	}
+
+	if ((off_t)len > store->size - offs) {
+		len = store->size - offs;
+	}
+
+	if (store->fd < 0) {
+		memcpy(data, store->mem + offs, len);
+		return (ssize_t)len;
+	}
+
+	do {
+		ret = pread(store->fd, data, len, offs);
+	} while ((ret < 0) && (errno == EINTR));
+
+	return (ret < 0) ? -errno : ret;
+}
+
+
+ssize_t store_write(store_t *store, const void *data, size_t len, off_t offs)
+{
+	ssize_t ret;
+
+	if (offs < 0) {
+		return -EINVAL;
+	}
+
+	if (offs >= store->size) {
+		return -ENOSPC;
+	}
+
+	if ((off_t)len > store->size - offs) {
+		len = store->size - offs;
+	}
+
+	if (store->fd < 0) {
+		memcpy(store->mem + offs, data, len);
+		return (ssize_t)len;
+	}
+
+	do {
+		ret = pwrite(store->fd, data, len, offs);
+	} while ((ret < 0) && (errno == EINTR));
+
+	return (ret < 0) ? -errno : ret;
+}
+
+
+void store_done(store_t *store)
+{
+	if (store->fd >= 0) {
+		close(store->fd);
+	}
+	free(store->mem);
+
+	store->mem = NULL;
+	store->fd = -1;
+	store->size = 0;
+}
+
+
+int store_init(store_t *store, const char *path, off_t size)
+{
+	struct stat st;
+
+	store->mem = NULL;
+	store->fd = -1;
+	store->size = size;
+
+	if (path == NULL) {
+		store->mem = calloc(1, size);
+		return (store->mem == NULL) ? -ENOMEM : 0;
+	}
+
+	store->fd = open(path, O_RDWR);
+	if (store->fd < 0) {
+		return -errno;
+	}
+
+	if (size == 0) {
+		if (fstat(store->fd, &st) < 0) {
+			size = -errno;
+			store_done(store);
+			return (int)size;
+		}
+		store->size = st.st_size;
+	}
+
+	return 0;
+}
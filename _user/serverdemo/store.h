@@ -0,0 +1,43 @@
+/*
+ * Phoenix-RTOS
+ *
+ * Server demo
+ *
+ * Backing store - RAM or file
+ *
+ * Copyright 2026 Phoenix Systems
+ *
+ * This file is part of Phoenix-RTOS.
+ *
+ * %LICENSE%
+ */
+
+#ifndef _SERVERDEMO_STORE_H_
+#define _SERVERDEMO_STORE_H_
+
+#include <sys/types.h>
+
+
+typedef struct {
+	unsigned char *mem; /* RAM store */
+	int fd;             /* File store, -1 if not used */
+	off_t size;
+} store_t;
+
+
+/* Reads are clipped to the store size */
+extern ssize_t store_read(store_t *store, void *data, size_t len, off_t offs);
+
+
+extern ssize_t store_write(store_t *store, const void *data, size_t len, off_t offs);
+
+
+extern void store_done(store_t *store);
+
+
+/* Creates a store of size bytes in RAM (path == NULL) or opens file,
+ * size 0 means the whole file */
+extern int store_init(store_t *store, const char *path, off_t size);
+
+
+#endif
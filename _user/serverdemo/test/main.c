@@ -0,0 +1,290 @@
+/*
+ * Phoenix-RTOS
+ *
+ * Server demo
+ *
+ * Host tests of the server demo, run against a server started by run.sh
+ *
+ * Copyright 2026 Phoenix Systems
+ *
+ * This file is part of Phoenix-RTOS.
+ *
+ * %LICENSE%
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/msg.h>
+#include <sys/threads.h>
+
+#include "../serverdemo.h"
+
+
+#define TEST_PAGES 3
+#define TEST_CHUNK 1024
+#define TEST_SHMSZ 4096
+
+
+static struct {
+	unsigned char buf[TEST_PAGES * 4096];
+	unsigned char rbuf[TEST_PAGES * 4096];
+
+	/* Shared memory transfer done by the reader thread */
+	oid_t oid;
+	unsigned int region;
+	int ret;
+	char stack[4096] __attribute__((aligned(8)));
+} test_common;
+
+
+static int test_io(int type, const char *path, void *data, size_t len, off_t offs)
+{
+	oid_t oid;
+	msg_t msg;
+	int err;
+
+	if (lookup(path, NULL, &oid) < 0) {
+		return -ENOENT;
+	}
+
+	memset(&msg, 0, sizeof(msg));
+	msg.type = type;
+	msg.oid = oid;
+	msg.i.io.offs = offs;
+	msg.i.io.len = len;
+
+	if (type == mtWrite) {
+		msg.i.data = data;
+		msg.i.size = len;
+	}
+	else {
+		msg.o.data = data;
+		msg.o.size = len;
+	}
+
+	err = msgSend(oid.port, &msg);
+
+	return (err < 0) ? err : msg.o.err;
+}
+
+
+/* The first read of a file at offset 0 is sequential, the readahead window has to be non-zero */
+static int test_cacheRead(void)
+{
+	size_t i;
+	int ret;
+
+	for (i = 0; i < sizeof(test_common.buf); ++i) {
+		test_common.buf[i] = (unsigned char)(i * 7 + 1);
+	}
+
+	ret = test_io(mtWrite, "/dev/serverdemo", test_common.buf, sizeof(test_common.buf), 0);
+	if (ret != (int)sizeof(test_common.buf)) {
+		fprintf(stderr, "write returned %d\n", ret);
+		return -1;
+	}
+
+	/* Sequential reads from offset 0, through the cache */
+	for (i = 0; i < sizeof(test_common.rbuf); i += TEST_CHUNK) {
+		ret = test_io(mtRead, "/dev/serverdemo", test_common.rbuf + i, TEST_CHUNK, i);
+		if (ret != TEST_CHUNK) {
+			fprintf(stderr, "read at %zu returned %d\n", i, ret);
+			return -1;
+		}
+	}
+
+	if (memcmp(test_common.buf, test_common.rbuf, sizeof(test_common.buf)) != 0) {
+		fprintf(stderr, "read data differs\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+
+/* Writes past the end of the file fail up front, not at the write-back flush */
+static int test_wbBounds(void)
+{
+	oid_t oid;
+	msg_t msg;
+	int ret;
+
+	if (lookup("/dev/serverdemo", NULL, &oid) < 0) {
+		return -1;
+	}
+
+	memset(&msg, 0, sizeof(msg));
+	msg.type = mtGetAttr;
+	msg.oid = oid;
+	msg.i.attr.type = atSize;
+	if ((msgSend(oid.port, &msg) < 0) || (msg.o.err < 0)) {
+		fprintf(stderr, "getattr failed\n");
+		return -1;
+	}
+
+	ret = test_io(mtWrite, "/dev/serverdemo", "abcd", 4, (off_t)msg.o.attr.val);
+	if (ret != -ENOSPC) {
+		fprintf(stderr, "write at the end returned %d\n", ret);
+		return -1;
+	}
+
+	ret = test_io(mtWrite, "/dev/serverdemo", "abcd", 4, -1);
+	if (ret != -EINVAL) {
+		fprintf(stderr, "write at -1 returned %d\n", ret);
+		return -1;
+	}
+
+	/* Clipped at the end of the file */
+	ret = test_io(mtWrite, "/dev/serverdemo", "abcd", 4, (off_t)msg.o.attr.val - 2);
+	if (ret != 2) {
+		fprintf(stderr, "write across the end returned %d\n", ret);
+		return -1;
+	}
+
+	return 0;
+}
+
+
+/* Sends a serverdemo_shmRead or serverdemo_shmWrite request */
+static int test_shmIo(const oid_t *oid, int type, unsigned int region, size_t shmOffs, size_t len)
+{
+	serverdemo_devctl_t *devctl;
+	msg_t msg;
+	int err;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.type = mtDevCtl;
+	msg.oid = *oid;
+	devctl = (serverdemo_devctl_t *)msg.i.raw;
+	devctl->type = type;
+	devctl->region = region;
+	devctl->io.offs = 0;
+	devctl->io.shmOffs = shmOffs;
+	devctl->io.len = len;
+
+	err = msgSend(oid->port, &msg);
+
+	return (err < 0) ? err : msg.o.err;
+}
+
+
+static void test_shmReader(void *arg)
+{
+	(void)arg;
+
+	test_common.ret = test_shmIo(&test_common.oid, serverdemo_shmRead, test_common.region, 2048, 64);
+
+	endthread();
+}
+
+
+/* Shared memory transfers are dispatched to the object type, a read of the empty FIFO waits for a writer */
+static int test_shmFifo(void)
+{
+	serverdemo_devctl_t *devctl;
+	serverdemo_devctlo_t *devctlo;
+	unsigned char *shm;
+	handle_t tid;
+	msg_t msg;
+	int ret, err = -1;
+
+	if (lookup("/dev/serverdemo-fifo", NULL, &test_common.oid) < 0) {
+		fprintf(stderr, "FIFO not found\n");
+		return -1;
+	}
+
+	memset(&msg, 0, sizeof(msg));
+	msg.type = mtDevCtl;
+	msg.oid = test_common.oid;
+	devctl = (serverdemo_devctl_t *)msg.i.raw;
+	devctl->type = serverdemo_shmMap;
+	devctl->map.size = TEST_SHMSZ;
+	if ((msgSend(test_common.oid.port, &msg) < 0) || (msg.o.err < 0)) {
+		fprintf(stderr, "shmMap failed\n");
+		return -1;
+	}
+
+	devctlo = (serverdemo_devctlo_t *)msg.o.raw;
+	test_common.region = devctlo->region;
+	shm = mmap(NULL, devctlo->size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS | MAP_PHYSMEM, -1, devctlo->paddr);
+	if (shm == MAP_FAILED) {
+		fprintf(stderr, "mmap of the region failed\n");
+		return -1;
+	}
+
+	do {
+		memcpy(shm, "hello", 5);
+		ret = test_shmIo(&test_common.oid, serverdemo_shmWrite, test_common.region, 0, 5);
+		if (ret != 5) {
+			fprintf(stderr, "shmWrite returned %d\n", ret);
+			break;
+		}
+
+		ret = test_shmIo(&test_common.oid, serverdemo_shmRead, test_common.region, 1024, 64);
+		if ((ret != 5) || (memcmp(shm + 1024, "hello", 5) != 0)) {
+			fprintf(stderr, "shmRead returned %d\n", ret);
+			break;
+		}
+
+		/* The FIFO is empty, the read is parked until the write below */
+		test_common.ret = 0;
+		if (beginthreadex(test_shmReader, 4, test_common.stack, sizeof(test_common.stack), NULL, &tid) < 0) {
+			fprintf(stderr, "beginthreadex failed\n");
+			break;
+		}
+		usleep(100000);
+
+		ret = test_io(mtWrite, "/dev/serverdemo-fifo", "world", 5, 0);
+		threadJoin(tid, 0);
+		if ((ret != 5) || (test_common.ret != 5) || (memcmp(shm + 2048, "world", 5) != 0)) {
+			fprintf(stderr, "parked shmRead returned %d, write %d\n", test_common.ret, ret);
+			break;
+		}
+
+		err = 0;
+	} while (0);
+
+	munmap(shm, TEST_SHMSZ);
+
+	memset(&msg, 0, sizeof(msg));
+	msg.type = mtDevCtl;
+	msg.oid = test_common.oid;
+	devctl = (serverdemo_devctl_t *)msg.i.raw;
+	devctl->type = serverdemo_shmUnmap;
+	devctl->region = test_common.region;
+	msgSend(test_common.oid.port, &msg);
+
+	return err;
+}
+
+
+static const struct {
+	const char *name;
+	int (*run)(void);
+} tests[] = {
+	{ "cache read from offset 0", test_cacheRead },
+	{ "shared memory transfers on the FIFO", test_shmFifo },
+	{ "write-back writes past the end of the file", test_wbBounds },
+};
+
+
+int main(void)
+{
+	unsigned int i, failed = 0;
+
+	for (i = 0; i < sizeof(tests) / sizeof(tests[0]); ++i) {
+		if (tests[i].run() < 0) {
+			printf("serverdemo-test: %s: FAILED\n", tests[i].name);
+			failed++;
+		}
+		else {
+			printf("serverdemo-test: %s: ok\n", tests[i].name);
+		}
+	}
+
+	return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
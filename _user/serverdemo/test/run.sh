@@ -0,0 +1,32 @@
+#!/bin/sh
+#
+# Runs the serverdemo host tests
+#
+# Starts serverdemo with a RAM store and write-back in a private device
+# directory and runs the test client against it.
+#   run.sh <serverdemo> <serverdemo-test>
+#
+# Copyright 2026 Phoenix Systems
+#
+
+set -e
+
+PHOENIX_HOST_DEV=$(mktemp -d)
+export PHOENIX_HOST_DEV
+
+"$1" -r 65536 -w 50 -v 0 &
+pid=$!
+trap 'kill $pid; rm -rf "$PHOENIX_HOST_DEV"' EXIT
+
+# The FIFO is registered last
+i=0
+while [ ! -e "$PHOENIX_HOST_DEV/serverdemo-fifo" ]; do
+	i=$((i + 1))
+	if [ $i -gt 50 ]; then
+		echo "run.sh: serverdemo did not start" >&2
+		exit 1
+	fi
+	sleep 0.1
+done
+
+"$2"
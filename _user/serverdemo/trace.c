@@ -0,0 +1,351 @@
+/*
+ * Phoenix-RTOS
+ *
+ * Server demo
+ *
+ * Request tracing - per message type latency histograms
+ *
+ * Every thread receiving messages puts the timestamps of the requests it
+ * responded to into its own ring. The rings are emptied into histograms
+ * of queueing (receive to handler), handler and response time for each
+ * message type when one of them fills up or a report is requested.
+ *
+ * Copyright 2026 Phoenix Systems
+ *
+ * This file is part of Phoenix-RTOS.
+ *
+ * %LICENSE%
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <sys/msg.h>
+#include <sys/threads.h>
+
+#include "trace.h"
+#include "srv.h"
+
+
+#define TRACE_RECS  256 /* per ring, power of 2 */
+#define TRACE_RINGS (SRV_THREADS_MAX + 1)
+
+/* Message types with own histograms, the last one collects all other */
+#define TRACE_TYPES (mtCount + 1)
+
+/* Latency histogram: 4 linear buckets per power of 2 up to 2^32 ns */
+#define TRACE_HIST_SUBBITS 2
+#define TRACE_HIST_SUB     (1 << TRACE_HIST_SUBBITS)
+#define TRACE_HIST_SIZE    ((32 - TRACE_HIST_SUBBITS + 1) * TRACE_HIST_SUB)
+
+
+enum { traceWait = 0, traceRun, traceResp, traceMetrics };
+
+
+typedef struct {
+	unsigned int type;
+	uint32_t lat[traceMetrics]; /* ns */
+} trace_rec_t;
+
+
+/* Single producer, emptied by whoever holds the trace lock */
+struct _trace_ring_t {
+	atomic_uint head;
+	atomic_uint tail;
+	trace_rec_t recs[TRACE_RECS];
+};
+
+
+typedef struct {
+	unsigned long long count;
+	uint32_t max[traceMetrics];
+	uint32_t hist[traceMetrics][TRACE_HIST_SIZE];
+} trace_type_t;
+
+
+static struct {
+	handle_t lock;      /* Histograms and consumer side of the rings */
+	handle_t sharedLock; /* Producer side of the shared ring */
+	trace_type_t *types;
+	trace_ring_t *rings[TRACE_RINGS];
+	atomic_uint nrings;
+	atomic_uint dropped;
+} trace_common;
+
+
+static const char *const trace_names[TRACE_TYPES] = {
+	[mtOpen] = "open",
+	[mtClose] = "close",
+	[mtRead] = "read",
+	[mtWrite] = "write",
+	[mtTruncate] = "truncate",
+	[mtDevCtl] = "devctl",
+	[mtSetAttr] = "setattr",
+	[mtGetAttr] = "getattr",
+	[mtCount] = "other",
+};
+
+
+unsigned long long trace_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+static unsigned int trace_histIdx(uint32_t v)
+{
+	unsigned int msb;
+
+	if (v < TRACE_HIST_SUB) {
+		return v;
+	}
+
+	msb = 31 - __builtin_clz(v);
+
+	return (msb - TRACE_HIST_SUBBITS + 1) * TRACE_HIST_SUB + ((v >> (msb - TRACE_HIST_SUBBITS)) & (TRACE_HIST_SUB - 1));
+}
+
+
+/* Returns the lower bound of the bucket */
+static uint32_t trace_histValue(unsigned int idx)
+{
+	unsigned int exp = idx / TRACE_HIST_SUB;
+
+	if (exp == 0) {
+		return idx;
+	}
+
+	return (uint32_t)(TRACE_HIST_SUB + idx % TRACE_HIST_SUB) << (exp - 1);
+}
+
+
+static uint32_t trace_histPercentile(const uint32_t *hist, unsigned long long total, unsigned int permille)
+{
+	unsigned long long rank = (total * permille + 999) / 1000, n = 0;
+	unsigned int i;
+
+	for (i = 0; i < TRACE_HIST_SIZE; ++i) {
+		n += hist[i];
+		if ((n >= rank) && (n != 0)) {
+			return trace_histValue(i);
+		}
+	}
+
+	return 0;
+}
+
+
+/* Moves the records of all rings to the histograms, called with the trace lock held */
+static void trace_drain(void)
+{
+	unsigned int i, j, m, tail, head, nrings;
+	trace_ring_t *ring;
+	trace_type_t *type;
+	trace_rec_t *rec;
+
+	nrings = atomic_load_explicit(&trace_common.nrings, memory_order_acquire);
+	for (i = 0; i < nrings; ++i) {
+		ring = trace_common.rings[i];
+		tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+		head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+		for (j = tail; j != head; ++j) {
+			rec = &ring->recs[j % TRACE_RECS];
+			type = &trace_common.types[rec->type];
+			type->count++;
+			for (m = 0; m < traceMetrics; ++m) {
+				type->hist[m][trace_histIdx(rec->lat[m])]++;
+				if (rec->lat[m] > type->max[m]) {
+					type->max[m] = rec->lat[m];
+				}
+			}
+		}
+
+		atomic_store_explicit(&ring->tail, head, memory_order_release);
+	}
+}
+
+
+static uint32_t trace_delta(unsigned long long from, unsigned long long to)
+{
+	if (to <= from) {
+		return 0;
+	}
+
+	return (to - from > UINT32_MAX) ? UINT32_MAX : (uint32_t)(to - from);
+}
+
+
+void trace_record(trace_ring_t *ring, int type, const trace_stamps_t *ts)
+{
+	unsigned long long now = trace_now();
+	unsigned int head, tail;
+	trace_rec_t *rec;
+
+	if (ring == NULL) {
+		ring = trace_common.rings[0];
+		mutexLock(trace_common.sharedLock);
+	}
+
+	head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+	if (head - tail == TRACE_RECS) {
+		atomic_fetch_add_explicit(&trace_common.dropped, 1, memory_order_relaxed);
+	}
+	else {
+		rec = &ring->recs[head % TRACE_RECS];
+		rec->type = ((type >= 0) && (type < mtCount)) ? (unsigned int)type : mtCount;
+		rec->lat[traceWait] = trace_delta(ts->recv, ts->start);
+		rec->lat[traceRun] = trace_delta(ts->start, ts->end);
+		rec->lat[traceResp] = trace_delta(ts->end, now);
+		atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+	}
+
+	if (ring == trace_common.rings[0]) {
+		mutexUnlock(trace_common.sharedLock);
+	}
+
+	/* Empty the rings when this one is 3/4 full, unless someone else does it */
+	if ((head + 1 - tail >= TRACE_RECS * 3 / 4) && (mutexTry(trace_common.lock) == 0)) {
+		trace_drain();
+		mutexUnlock(trace_common.lock);
+	}
+}
+
+
+trace_ring_t *trace_ringAlloc(void)
+{
+	trace_ring_t *ring;
+	unsigned int i;
+
+	ring = calloc(1, sizeof(*ring));
+	if (ring == NULL) {
+		return NULL;
+	}
+
+	mutexLock(trace_common.lock);
+	i = atomic_load_explicit(&trace_common.nrings, memory_order_relaxed);
+	if (i == TRACE_RINGS) {
+		mutexUnlock(trace_common.lock);
+		free(ring);
+		return NULL;
+	}
+	trace_common.rings[i] = ring;
+	atomic_store_explicit(&trace_common.nrings, i + 1, memory_order_release);
+	mutexUnlock(trace_common.lock);
+
+	return ring;
+}
+
+
+size_t trace_report(char *buf, size_t size)
+{
+	static const char *const metrics[traceMetrics] = { "wait", "run", "resp" };
+	const trace_type_t *type;
+	uint32_t p50, p99;
+	size_t len = 0;
+	unsigned int i, m;
+	int n;
+
+#define TRACE_PRINT(...) \
+	do { \
+		n = snprintf(buf + len, size - len, __VA_ARGS__); \
+		len = ((n < 0) || ((size_t)n >= size - len)) ? size - 1 : len + n; \
+	} while (0)
+
+	if (size == 0) {
+		return 0;
+	}
+	buf[0] = '\0';
+
+	mutexLock(trace_common.lock);
+	trace_drain();
+
+	TRACE_PRINT("%-8s %10s", "type", "count");
+	for (m = 0; m < traceMetrics; ++m) {
+		TRACE_PRINT("%s%4s p50/p99/max us", (m == 0) ? "  " : "        ", metrics[m]);
+	}
+	TRACE_PRINT("\n");
+
+	for (i = 0; i < TRACE_TYPES; ++i) {
+		type = &trace_common.types[i];
+		if (type->count == 0) {
+			continue;
+		}
+
+		if (trace_names[i] != NULL) {
+			TRACE_PRINT("%-8s %10llu", trace_names[i], type->count);
+		}
+		else {
+			TRACE_PRINT("type%-4u %10llu", i, type->count);
+		}
+
+		for (m = 0; m < traceMetrics; ++m) {
+			p50 = trace_histPercentile(type->hist[m], type->count, 500);
+			p99 = trace_histPercentile(type->hist[m], type->count, 990);
+			TRACE_PRINT("  %5u.%01u/%5u.%01u/%7u.%01u", p50 / 1000, (p50 % 1000) / 100, p99 / 1000, (p99 % 1000) / 100,
+				type->max[m] / 1000, (type->max[m] % 1000) / 100);
+		}
+		TRACE_PRINT("\n");
+	}
+
+	TRACE_PRINT("dropped %u\n", atomic_load_explicit(&trace_common.dropped, memory_order_relaxed));
+	mutexUnlock(trace_common.lock);
+
+#undef TRACE_PRINT
+
+	return len;
+}
+
+
+void trace_reset(void)
+{
+	mutexLock(trace_common.lock);
+	trace_drain();
+	memset(trace_common.types, 0, TRACE_TYPES * sizeof(trace_type_t));
+	atomic_store_explicit(&trace_common.dropped, 0, memory_order_relaxed);
+	mutexUnlock(trace_common.lock);
+}
+
+
+int trace_init(void)
+{
+	int err;
+
+	trace_common.types = calloc(TRACE_TYPES, sizeof(trace_type_t));
+	if (trace_common.types == NULL) {
+		return -ENOMEM;
+	}
+
+	err = mutexCreate(&trace_common.lock);
+	if (err < 0) {
+		free(trace_common.types);
+		return err;
+	}
+
+	err = mutexCreate(&trace_common.sharedLock);
+	if (err < 0) {
+		resourceDestroy(trace_common.lock);
+		free(trace_common.types);
+		return err;
+	}
+
+	/* Ring 0 is the shared one */
+	if (trace_ringAlloc() == NULL) {
+		resourceDestroy(trace_common.sharedLock);
+		resourceDestroy(trace_common.lock);
+		free(trace_common.types);
+		return -ENOMEM;
+	}
+
+	return 0;
+}
@@ -0,0 +1,56 @@
+/*
+ * Phoenix-RTOS
+ *
+ * Server demo
+ *
+ * Request tracing - per message type latency histograms
+ *
+ * Copyright 2026 Phoenix Systems
+ *
+ * This file is part of Phoenix-RTOS.
+ *
+ * %LICENSE%
+ */
+
+#ifndef _SERVERDEMO_TRACE_H_
+#define _SERVERDEMO_TRACE_H_
+
+#include <stddef.h>
+
+
+typedef struct _trace_ring_t trace_ring_t;
+
+
+/* Timestamps of a request in ns, the response time is taken by trace_record() */
+typedef struct {
+	unsigned long long recv;  /* msgRecv() returned */
+	unsigned long long start; /* Last handler call started */
+	unsigned long long end;   /* Last handler call returned */
+} trace_stamps_t;
+
+
+extern unsigned long long trace_now(void);
+
+
+/* Returns the ring of the calling thread, NULL if it can't be allocated.
+ * Every thread receiving messages gets its own ring. */
+extern trace_ring_t *trace_ringAlloc(void);
+
+
+/* Records a responded request. Lock-free for the owner of the ring,
+ * a NULL ring selects the shared one used by other threads. */
+extern void trace_record(trace_ring_t *ring, int type, const trace_stamps_t *ts);
+
+
+/* Writes a text report of the histograms, returns its length */
+extern size_t trace_report(char *buf, size_t size);
+
+
+/* Clears the histograms */
+extern void trace_reset(void);
+
+
+extern int trace_init(void);
+
+
+#endif
@@ -0,0 +1,221 @@
+/*
+ * Phoenix-RTOS
+ *
+ * Server demo
+ *
+ * Write-back buffering of small writes
+ *
+ * Copyright 2026 Phoenix Systems
+ *
+ * This file is part of Phoenix-RTOS.
+ *
+ * %LICENSE%
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include "wb.h"
+
+
+#define WB_PRIO    4
+#define WB_STACKSZ 4096
+
+
+static struct {
+	handle_t lock;
+	handle_t cond;
+	wb_buf_t *dirty;
+	int pending; /* Flush requested, checked before waiting */
+	wb_flush_t flush;
+	time_t timeout;
+	char stack[WB_STACKSZ] __attribute__((aligned(8)));
+} wb_common;
+
+
+static time_t wb_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (time_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+
+static void wb_queue(wb_buf_t *buf, int urgent)
+{
+	mutexLock(wb_common.lock);
+	if (buf->queued == 0) {
+		buf->queued = 1;
+		buf->next = wb_common.dirty;
+		wb_common.dirty = buf;
+	}
+	if (urgent != 0) {
+		wb_common.pending = 1;
+		condSignal(wb_common.cond);
+	}
+	mutexUnlock(wb_common.lock);
+}
+
+
+int wb_flush(wb_buf_t *buf)
+{
+	ssize_t ret;
+	size_t done = 0;
+	int err = buf->err;
+
+	while (done < buf->len) {
+		ret = wb_common.flush(buf->arg, buf->data + done, buf->len - done, buf->offs + done);
+		if (ret <= 0) {
+			err = (ret < 0) ? (int)ret : -EIO;
+			break;
+		}
+		done += ret;
+	}
+
+	buf->len = 0;
+	buf->err = 0;
+	atomic_store_explicit(&buf->dirty, 0, memory_order_release);
+
+	return err;
+}
+
+
+ssize_t wb_write(wb_buf_t *buf, const void *data, size_t len, off_t offs)
+{
+	int err;
+
+	/* Fail now, the flush error would only reach the next request */
+	if ((offs < 0) || (offs >= buf->size)) {
+		return (offs < 0) ? -EINVAL : -ENOSPC;
+	}
+
+	if ((off_t)len > buf->size - offs) {
+		len = buf->size - offs;
+	}
+
+	/* Append to the buffered extent if adjacent, otherwise start a new one */
+	if ((buf->len != 0) && ((offs != buf->offs + (off_t)buf->len) || (buf->len + len > WB_BUFSZ))) {
+		err = wb_flush(buf);
+		if (err < 0) {
+			return err;
+		}
+	}
+
+	if ((len > WB_THRESHOLD) || (buf->err < 0)) {
+		err = wb_flush(buf);
+		return (err < 0) ? err : wb_common.flush(buf->arg, data, len, offs);
+	}
+
+	if (buf->data == NULL) {
+		buf->data = malloc(WB_BUFSZ);
+		if (buf->data == NULL) {
+			return wb_common.flush(buf->arg, data, len, offs);
+		}
+	}
+
+	if (buf->len == 0) {
+		buf->offs = offs;
+		buf->stamp = wb_now();
+		atomic_store_explicit(&buf->dirty, 1, memory_order_release);
+	}
+
+	memcpy(buf->data + buf->len, data, len);
+	buf->len += len;
+
+	wb_queue(buf, buf->len >= WB_THRESHOLD);
+
+	return (ssize_t)len;
+}
+
+
+static void wb_thread(void *arg)
+{
+	wb_buf_t *list, *buf;
+	time_t now, next, deadline;
+
+	(void)arg;
+
+	next = wb_now() + wb_common.timeout;
+
+	mutexLock(wb_common.lock);
+	for (;;) {
+		/* Requests made while the buffers were being flushed aren't lost */
+		while (wb_common.pending == 0) {
+			now = wb_now();
+			if (now >= next) {
+				break;
+			}
+			condWait(wb_common.cond, wb_common.lock, next - now);
+		}
+		wb_common.pending = 0;
+
+		list = wb_common.dirty;
+		wb_common.dirty = NULL;
+	wb_common.pending = 0;
+
+		/* Buffers queued later are due no earlier than a timeout from now */
+		now = wb_now();
+		next = now + wb_common.timeout;
+		while (list != NULL) {
+			/* Buffers leave the list one by one under the lock, once queued
+			 * is cleared wb_queue() may link the buffer to the dirty list */
+			buf = list;
+			list = list->next;
+			buf->queued = 0;
+			mutexUnlock(wb_common.lock);
+
+			mutexLock(buf->lock);
+			if (buf->len != 0) {
+				deadline = buf->stamp + wb_common.timeout;
+				if ((buf->len >= WB_THRESHOLD) || (now >= deadline)) {
+					/* Nobody waits for the result, keep it for the next request */
+					buf->err = wb_flush(buf);
+				}
+				else {
+					/* Wake up when the oldest buffer is due */
+					wb_queue(buf, 0);
+					if (deadline < next) {
+						next = deadline;
+					}
+				}
+			}
+			mutexUnlock(buf->lock);
+
+			mutexLock(wb_common.lock);
+		}
+	}
+}
+
+
+void wb_bufInit(wb_buf_t *buf, handle_t lock, void *arg, off_t size)
+{
+	memset(buf, 0, sizeof(*buf));
+	buf->lock = lock;
+	buf->arg = arg;
+	buf->size = size;
+	atomic_init(&buf->dirty, 0);
+}
+
+
+int wb_init(wb_flush_t flush, time_t timeout)
+{
+	wb_common.flush = flush;
+	wb_common.timeout = timeout;
+	wb_common.dirty = NULL;
+	wb_common.pending = 0;
+
+	if (mutexCreate(&wb_common.lock) < 0) {
+		return -ENOMEM;
+	}
+
+	if (condCreate(&wb_common.cond) < 0) {
+		resourceDestroy(wb_common.lock);
+		return -ENOMEM;
+	}
+
+	return beginthread(wb_thread, WB_PRIO, wb_common.stack, sizeof(wb_common.stack), NULL);
+}
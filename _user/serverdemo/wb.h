@@ -0,0 +1,79 @@
+/*
+ * Phoenix-RTOS
+ *
+ * Server demo
+ *
+ * Write-back buffering of small writes
+ *
+ * Copyright 2026 Phoenix Systems
+ *
+ * This file is part of Phoenix-RTOS.
+ *
+ * %LICENSE%
+ */
+
+#ifndef _SERVERDEMO_WB_H_
+#define _SERVERDEMO_WB_H_
+
+#include <stdatomic.h>
+#include <sys/types.h>
+#include <sys/threads.h>
+
+
+#define WB_BUFSZ     4096
+#define WB_THRESHOLD (3 * WB_BUFSZ / 4) /* Buffered bytes that trigger flush */
+
+
+/* Writes buffered data out, called with the buffer owner lock held */
+typedef ssize_t (*wb_flush_t)(void *arg, const void *data, size_t len, off_t offs);
+
+
+/* Buffer of one object, all fields but the list ones are protected by the owner lock */
+typedef struct _wb_buf_t {
+	struct _wb_buf_t *next; /* Dirty list, protected by the write-back lock */
+	int queued;
+
+	handle_t lock;
+	void *arg;
+	off_t size;          /* Size of the file written through the buffer */
+	unsigned char *data; /* Allocated on the first buffered write */
+	off_t offs;
+	size_t len;
+	time_t stamp; /* When the buffer became dirty */
+	int err;      /* Error of the background flush, reported by the next call */
+	atomic_int dirty;
+} wb_buf_t;
+
+
+/* Buffers data if possible, otherwise flushes and writes through. Writes
+ * past the end of the file fail up front. Called with the owner lock held. */
+extern ssize_t wb_write(wb_buf_t *buf, const void *data, size_t len, off_t offs);
+
+
+/* Writes buffered data out, called with the owner lock held */
+extern int wb_flush(wb_buf_t *buf);
+
+
+/* Flushes the buffer, if it's dirty. Lock-free check for the read path. */
+static inline int wb_sync(wb_buf_t *buf)
+{
+	int err = 0;
+
+	if (atomic_load_explicit(&buf->dirty, memory_order_acquire) != 0) {
+		mutexLock(buf->lock);
+		err = wb_flush(buf);
+		mutexUnlock(buf->lock);
+	}
+
+	return err;
+}
+
+
+extern void wb_bufInit(wb_buf_t *buf, handle_t lock, void *arg, off_t size);
+
+
+/* Starts the flusher thread, data is flushed at most timeout us after being written */
+extern int wb_init(wb_flush_t flush, time_t timeout);
+
+
+#endif
@@ -14,18 +14,119 @@
  */
 
 #include <errno.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
 #include <signal.h>
 #include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/threads.h>
+
+#ifdef VOXEL_NOGRAPH
+/* Built without libgraph, frames are rendered to memory only (-b) */
+typedef struct {
+	void *data;
+	unsigned int width;
+	unsigned int height;
+	unsigned char depth;
+} graph_t;
+#else
 #include <graph.h>
+#endif
+
+
+#define VOXEL_THREADS_MAX 16
+#define VOXEL_STACKSZ     4096
+#define VOXEL_PRIO        4
+
+/* Band boundaries in pixels, keeps bands of neighbouring threads on separate cache lines */
+#define VOXEL_BAND_ALIGN 16
+
+/* Columns per iteration of the vector kernel, generic vectors map to SSE2/AVX2 or NEON */
+#if defined(VOXEL_FIXED)
+/* Fixed-point build for targets without a fast FPU, scalar kernel only */
+#elif defined(__AVX2__)
+#define VOXEL_SIMD  1
+#define VOXEL_LANES 8
+#elif defined(__SSE2__) || defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define VOXEL_SIMD  1
+#define VOXEL_LANES 4
+#endif
+
+
+/* Map cells are stored in square tiles of 2^VOXEL_TILE_SHIFT cells, 0 gives row-major order */
+#ifndef VOXEL_TILE_SHIFT
+#define VOXEL_TILE_SHIFT 3
+#endif
+
+#define VOXEL_SKY 0x6c9eff
+
+/* Columns rendered to a thread's column-major scratch at a time, the scratch stays in L2 */
+#define VOXEL_CHUNK 64
+
+/* Side of the square blocks in which columns are transposed to rows, one cache line of pixels */
+#define VOXEL_BLOCK 16
+
+/* Golden frame check, pixels with a channel off by more than DELTA differ, up to LIMIT per mille may differ */
+#define VOXEL_GOLDEN_DELTA 48
+#define VOXEL_GOLDEN_LIMIT 20
+
+/* Terrain generation, the map only depends on the seed, not on the number of threads */
+#define VOXEL_SEED          0x2021
+#define VOXEL_SMOOTH_PASSES 20
+#define VOXEL_SMOOTH_RING   ((VOXEL_SMOOTH_PASSES - 1) * 3 * 1024)
+
+/* Generated maps are 2^10 cells square, terrain files may be up to 2^14 (the Q16.16 positions wrap at 65536) */
+#define VOXEL_MAP_SHIFT     10
+#define VOXEL_MAP_SHIFT_MAX 14
+#define VOXEL_MAP_MAGIC     "VXM1"
 
 
 volatile unsigned int flagQuit;
 
 
+typedef struct _voxel_opts_t {
+	unsigned int nthreads;
+	unsigned int frames;
+	unsigned int bench;
+	unsigned int width;
+	unsigned int height;
+	int simd;
+	int direct;
+	int transpose;
+	const char *save;
+	const char *check;
+	const char *load;
+	const char *store;
+} voxel_opts_t;
+
+
+typedef struct _cell_t {
+	uint8_t height;
+	uint8_t color;
+} cell_t;
+
+
+/*
+ * Terrain file header, followed by 2^(2 * shift) cells in the order of voxel_cellIdx(),
+ * so the renderer uses the file mapping as is. Nothing in the build makes or installs the
+ * file, it has to be written with -M (e.g. by the host build) and put into the image by
+ * hand. The demo then maps it with -m instead of generating terrain.
+ */
+typedef struct _voxel_maphdr_t {
+	char magic[4];
+	uint8_t shift;  /* map is 2^shift cells square */
+	uint8_t tile;   /* VOXEL_TILE_SHIFT of the cell order */
+	uint8_t cellsz; /* sizeof(cell_t) */
+	uint8_t reserved[9];
+} voxel_maphdr_t;
+
+
 typedef struct _camera_t {
 	float x, y, h;
 	float angle;
@@ -34,15 +135,114 @@ typedef struct _camera_t {
 } camera_t;
 
 
-typedef struct _voxel_t {
+#ifdef VOXEL_FIXED
+
+/* Map positions in Q16.16, wrapping of uint32_t is harmless as 65536 is a multiple of the map size */
+#define FX_SHIFT 16
+#define FX_ONE   (1 << FX_SHIFT)
+
+/* Projection scale in Q12, keeps (h - height) * invz within 32 bits */
+#define FX_INVZ_SHIFT 12
+
+
+typedef struct _slice_t {
+	uint32_t ax, ay;
+	int32_t dx, dy;
+	int32_t invz;
+} slice_t;
+
+
+/* Depths are the same every frame, they are computed once at start */
+typedef struct _depth_t {
+	int32_t z;
+	int32_t invz;
+} depth_t;
+
+#else
+
+typedef struct _slice_t {
+	float ax, ay;
+	float dx, dy;
+	float invz;
+} slice_t;
+
+#endif
+
+
+typedef struct _voxel_t voxel_t;
+
+
+typedef void (*voxel_job_t)(voxel_t *v, unsigned int band, unsigned int from, unsigned int to);
+
+
+/* Per band stage times in ns, on separate cache lines as every band updates its own */
+typedef struct _voxel_stage_t {
+	unsigned long long view;
+	unsigned long long sky;
+} __attribute__((aligned(64))) voxel_stage_t;
+
+
+typedef struct _voxel_worker_t {
+	voxel_t *v;
+	unsigned int band;
+	handle_t tid;
+	char stack[VOXEL_STACKSZ] __attribute__((aligned(8)));
+} voxel_worker_t;
+
+
+struct _voxel_t {
 	int *bufBack;
 	uint8_t *mapHeight;
 	uint8_t *mapColor;
+	cell_t *map;
+	unsigned int mapShift;
+	void *mapFile; /* terrain file mapping, map points into it */
+	size_t mapFileSz;
 	uint32_t *pixels, *palette;
+	uint32_t *screen; /* adapter framebuffer, NULL if pixels points to it */
+	uint32_t *columns; /* column-major scratch of each band, NULL if drawing to pixels */
+	unsigned int colStep, rowStep; /* pixels between columns and rows of the buffer drawn to */
 	unsigned int width;
 	unsigned int height;
 	camera_t cam;
-} voxel_t;
+	int simd;
+	graph_t *graph; /* NULL if rendering offscreen */
+
+	/* Stage timing, enabled in -b mode */
+	int timing;
+	unsigned long long commit;
+	voxel_stage_t stages[VOXEL_THREADS_MAX];
+#ifdef VOXEL_FIXED
+	depth_t *depths;
+	unsigned int ndepths;
+#endif
+
+	/* Terrain generation job arguments and times in ns */
+	struct {
+		uint32_t seed;
+		unsigned int p;
+		int passes;
+		const uint8_t *src;
+		uint8_t *dst;
+		uint8_t *ring;
+		unsigned long long plasma;
+		unsigned long long smooth;
+		unsigned long long pack;
+	} gen;
+
+	/* Worker pool, band 0 of every job is run by the calling thread */
+	struct {
+		handle_t lock, cond, done;
+		voxel_job_t job;
+		unsigned int n;
+		unsigned int seq;
+		unsigned int pending;
+		unsigned int nbands;
+		unsigned int nworkers;
+		int quit;
+		voxel_worker_t *workers;
+	} pool;
+};
 
 
 static inline int clamp(int x)
@@ -51,6 +251,18 @@ static inline int clamp(int x)
 }
 
 
+/* Index of cell (x, y) wrapped to a 2^shift map, rays that turn to a neighbouring row stay in the same tile */
+static inline unsigned int voxel_cellIdx(unsigned int shift, unsigned int x, unsigned int y)
+{
+	const unsigned int t = VOXEL_TILE_SHIFT, m = (1 << VOXEL_TILE_SHIFT) - 1;
+
+	x &= (1u << shift) - 1;
+	y &= (1u << shift) - 1;
+
+	return ((y & ~m) << shift) | ((x & ~m) << t) | ((y & m) << t) | (x & m);
+}
+
+
 static int interpolate(uint32_t *tab, uint32_t a, uint32_t b, int n)
 {
 	unsigned int j;
@@ -68,35 +280,240 @@ static int interpolate(uint32_t *tab, uint32_t a, uint32_t b, int n)
 
 static void voxel_free(voxel_t *v)
 {
+#ifdef VOXEL_FIXED
+	free(v->depths);
+#endif
 	free(v->palette);
-	free(v->pixels);
+	free(v->columns);
+	if (v->screen != NULL)
+		free(v->pixels);
 	free(v->bufBack);
+	if (v->mapFile != NULL)
+		munmap(v->mapFile, v->mapFileSz);
+	else
+		free(v->map);
 	free(v->mapColor);
 	free(v->mapHeight);
 }
 
 
-static int voxel_init(voxel_t *v, graph_t *g)
+static unsigned long long voxel_now(void)
 {
-	do {
-		if (g->width < 800 || g->height < 600)
-			return -1;
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (unsigned long long)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+static void voxel_band(voxel_t *v, unsigned int band, unsigned int *from, unsigned int *to)
+{
+	unsigned int n = v->pool.n, nbands = v->pool.nbands;
 
-		if ((v->mapHeight = malloc(1024 * 1024)) == NULL)
+	*from = (n * band / nbands) & ~(VOXEL_BAND_ALIGN - 1);
+
+	if (band + 1 == nbands)
+		*to = n;
+	else
+		*to = (n * (band + 1) / nbands) & ~(VOXEL_BAND_ALIGN - 1);
+}
+
+
+static void voxel_worker(void *arg)
+{
+	voxel_worker_t *w = arg;
+	voxel_t *v = w->v;
+	voxel_job_t job;
+	unsigned int seq = 0, from, to;
+
+	mutexLock(v->pool.lock);
+	for (;;) {
+		while (v->pool.seq == seq && !v->pool.quit)
+			condWait(v->pool.cond, v->pool.lock, 0);
+
+		if (v->pool.quit)
 			break;
 
-		if ((v->mapColor = malloc(1024 * 1024)) == NULL)
+		seq = v->pool.seq;
+		if (w->band >= v->pool.nbands)
+			continue;
+
+		job = v->pool.job;
+		voxel_band(v, w->band, &from, &to);
+		mutexUnlock(v->pool.lock);
+
+		job(v, w->band, from, to);
+
+		mutexLock(v->pool.lock);
+		if (--v->pool.pending == 0)
+			condSignal(v->pool.done);
+	}
+	mutexUnlock(v->pool.lock);
+
+	endthread();
+}
+
+
+/* Splits [0, n) into bands run in parallel by the pool, returns when all bands are done */
+static void voxel_parallel(voxel_t *v, voxel_job_t job, unsigned int n)
+{
+	unsigned int from, to;
+
+	mutexLock(v->pool.lock);
+	v->pool.job = job;
+	v->pool.n = n;
+	v->pool.pending = v->pool.nbands - 1;
+	v->pool.seq++;
+	if (v->pool.pending > 0)
+		condBroadcast(v->pool.cond);
+	voxel_band(v, 0, &from, &to);
+	mutexUnlock(v->pool.lock);
+
+	job(v, 0, from, to);
+
+	mutexLock(v->pool.lock);
+	while (v->pool.pending > 0)
+		condWait(v->pool.done, v->pool.lock, 0);
+	mutexUnlock(v->pool.lock);
+}
+
+
+static void voxel_setBands(voxel_t *v, unsigned int nbands)
+{
+	mutexLock(v->pool.lock);
+	v->pool.nbands = nbands;
+	mutexUnlock(v->pool.lock);
+}
+
+
+static void voxel_poolDone(voxel_t *v)
+{
+	unsigned int i;
+
+	mutexLock(v->pool.lock);
+	v->pool.quit = 1;
+	condBroadcast(v->pool.cond);
+	mutexUnlock(v->pool.lock);
+
+	for (i = 0; i < v->pool.nworkers; i++)
+		threadJoin(v->pool.workers[i].tid, 0);
+
+	free(v->pool.workers);
+	resourceDestroy(v->pool.done);
+	resourceDestroy(v->pool.cond);
+	resourceDestroy(v->pool.lock);
+}
+
+
+static int voxel_poolInit(voxel_t *v, unsigned int nthreads)
+{
+	voxel_worker_t *w;
+	unsigned int i;
+
+	v->pool.nbands = 1;
+
+	if (mutexCreate(&v->pool.lock) < 0)
+		return -1;
+
+	if (condCreate(&v->pool.cond) < 0) {
+		resourceDestroy(v->pool.lock);
+		return -1;
+	}
+
+	if (condCreate(&v->pool.done) < 0) {
+		resourceDestroy(v->pool.cond);
+		resourceDestroy(v->pool.lock);
+		return -1;
+	}
+
+	if (nthreads > 1 && (v->pool.workers = malloc((nthreads - 1) * sizeof(voxel_worker_t))) == NULL) {
+		voxel_poolDone(v);
+		return -1;
+	}
+
+	for (i = 0; i < nthreads - 1; i++) {
+		w = &v->pool.workers[i];
+		w->v = v;
+		w->band = i + 1;
+
+		if (beginthreadex(voxel_worker, VOXEL_PRIO, w->stack, VOXEL_STACKSZ, w, &w->tid) < 0)
 			break;
+	}
+
+	v->pool.nworkers = i;
+	v->pool.nbands = i + 1;
+
+	return EOK;
+}
+
+
+#ifdef VOXEL_FIXED
+
+/* Takes the same depth steps as the float renderer */
+static int voxel_initDepths(voxel_t *v)
+{
+	unsigned int n;
+	float z, dz;
+
+	for (n = 0, z = 1.0f, dz = 1.0f; z < v->cam.dist; n++) {
+		dz += 0.0005;
+		z += dz;
+	}
 
+	if ((v->depths = malloc(n * sizeof(depth_t))) == NULL)
+		return -1;
+
+	for (n = 0, z = 1.0f, dz = 1.0f; z < v->cam.dist; n++) {
+		v->depths[n].z = z * FX_ONE + 0.5f;
+		v->depths[n].invz = 1.0f / z * 120 * (1 << FX_INVZ_SHIFT) + 0.5f;
+		dz += 0.0005;
+		z += dz;
+	}
+	v->ndepths = n;
+
+	return EOK;
+}
+
+#endif
+
+
+/*
+ * Frames are drawn to a back buffer copied to the framebuffer at commit, unless direct is set.
+ * With transpose columns go through a column-major scratch, otherwise straight to the rows.
+ */
+static int voxel_init(voxel_t *v, graph_t *g, unsigned int nthreads, int direct, int transpose)
+{
+	do {
 		if ((v->bufBack = malloc(g->width * sizeof(int))) == NULL)
 			break;
 
-		if ((v->pixels = malloc(g->width * g->height * g->depth)) == NULL)
-			break;
+		if (transpose) {
+			if ((v->columns = malloc(nthreads * VOXEL_CHUNK * g->height * sizeof(uint32_t))) == NULL)
+				break;
+			v->colStep = g->height;
+			v->rowStep = 1;
+		}
+		else {
+			v->colStep = 1;
+			v->rowStep = g->width;
+		}
 
 		if ((v->palette = malloc(256 * g->depth)) == NULL)
 			break;
 
+#ifdef VOXEL_FIXED
+		if (voxel_initDepths(v) < 0)
+			break;
+#endif
+
+		if (direct)
+			v->pixels = g->data;
+		else if ((v->pixels = malloc(g->width * g->height * g->depth)) != NULL)
+			v->screen = g->data;
+		else
+			break;
+
 		v->width = g->width;
 		v->height = g->height;
 
@@ -109,186 +526,686 @@ static int voxel_init(voxel_t *v, graph_t *g)
 }
 
 
-static void voxel_drawLine(uint32_t *pixel, int width, int x, int ht, int hb, uint32_t rgb)
+/* Fills rows [ht, hb) of a column, rows are step pixels apart */
+static void voxel_drawLine(uint32_t *column, unsigned int step, int ht, int hb, uint32_t rgb)
 {
 	if (ht < 0)
 		ht = 0;
 
-	if (ht >= hb)
-		return;
+	while (ht < hb)
+		column[ht++ * step] = rgb;
+}
+
+
+#ifdef VOXEL_FIXED
+
+static void voxel_drawSpan(voxel_t *v, const slice_t *s, uint32_t *cols, unsigned int from, unsigned int to)
+{
+	int hs, h = v->cam.h, horiz = v->cam.horiz;
+	uint32_t px, py;
+	unsigned int i;
+	const cell_t *cell;
+
+	px = s->ax + (uint32_t)s->dx * from;
+	py = s->ay + (uint32_t)s->dy * from;
+
+	for (i = from; i < to; i++) {
+		cell = &v->map[voxel_cellIdx(v->mapShift, px >> FX_SHIFT, py >> FX_SHIFT)];
 
-	pixel += ht * width + x;
-	while (ht < hb) {
-		*pixel = rgb;
-		pixel += width;
-		ht++;
+		hs = (((h - cell->height) * s->invz) >> FX_INVZ_SHIFT) + horiz;
+
+		voxel_drawLine(cols + (i - from) * v->colStep, v->rowStep, hs, v->bufBack[i], v->palette[cell->color]);
+
+		if (hs < v->bufBack[i])
+			v->bufBack[i] = hs;
+
+		px += s->dx;
+		py += s->dy;
 	}
 }
 
 
-static void voxel_drawView(voxel_t *v)
+/* Float is used only for a few per-band conversions, columns and depths are stepped in integers */
+static void voxel_drawView(voxel_t *v, uint32_t *cols, unsigned int from, unsigned int to)
+{
+	int32_t cosa = cosf(v->cam.angle) * FX_ONE;
+	int32_t sina = sinf(v->cam.angle) * FX_ONE;
+	uint32_t camx = (int64_t)(v->cam.x * FX_ONE);
+	uint32_t camy = (int64_t)(v->cam.y * FX_ONE);
+	int32_t cosz, sinz;
+	unsigned int i;
+	slice_t s;
+
+	for (i = from; i < to; i++)
+		v->bufBack[i] = v->height;
+
+	for (i = 0; i < v->ndepths; i++) {
+		cosz = ((int64_t)cosa * v->depths[i].z) >> FX_SHIFT;
+		sinz = ((int64_t)sina * v->depths[i].z) >> FX_SHIFT;
+
+		s.ax = camx + (uint32_t)(-cosz - sinz);
+		s.ay = camy + (uint32_t)(sinz - cosz);
+		s.dx = 2 * cosz / (int32_t)v->width;
+		s.dy = -2 * sinz / (int32_t)v->width;
+		s.invz = v->depths[i].invz;
+
+		voxel_drawSpan(v, &s, cols, from, to);
+	}
+}
+
+#else
+
+/* Columns of a slice are sampled at (ax + dx * i, ay + dy * i), so both kernels and all bands agree */
+static void voxel_drawSpan(voxel_t *v, const slice_t *s, uint32_t *cols, unsigned int from, unsigned int to)
+{
+	int hs;
+	unsigned int i;
+	const cell_t *cell;
+
+	for (i = from; i < to; i++) {
+		cell = &v->map[voxel_cellIdx(v->mapShift, (int)(s->ax + s->dx * i), (int)(s->ay + s->dy * i))];
+
+		hs = (v->cam.h - cell->height) * s->invz + v->cam.horiz;
+
+		voxel_drawLine(cols + (i - from) * v->colStep, v->rowStep, hs, v->bufBack[i], v->palette[cell->color]);
+
+		if (hs < v->bufBack[i])
+			v->bufBack[i] = hs;
+	}
+}
+
+
+#ifdef VOXEL_SIMD
+
+typedef float vfloat_t __attribute__((vector_size(VOXEL_LANES * sizeof(float))));
+typedef int32_t vint_t __attribute__((vector_size(VOXEL_LANES * sizeof(int32_t))));
+
+
+/* Draws VOXEL_LANES columns per iteration, returns the first column left for the scalar tail */
+static unsigned int voxel_drawSpanSimd(voxel_t *v, const slice_t *s, uint32_t *cols, unsigned int from, unsigned int to)
+{
+	vfloat_t col, hs;
+	vint_t x, y, idx, h, ht, hb, mask;
+	const int32_t tm = (1 << VOXEL_TILE_SHIFT) - 1, mm = (1 << v->mapShift) - 1;
+	const unsigned int shift = v->mapShift;
+	unsigned int i, k;
+
+	for (k = 0; k < VOXEL_LANES; k++)
+		col[k] = from + k;
+
+	for (i = from; i + VOXEL_LANES <= to; i += VOXEL_LANES) {
+		x = __builtin_convertvector(s->ax + s->dx * col, vint_t) & mm;
+		y = __builtin_convertvector(s->ay + s->dy * col, vint_t) & mm;
+
+		/* Same as voxel_cellIdx() */
+		idx = ((y & ~tm) << shift) | ((x & ~tm) << VOXEL_TILE_SHIFT) | ((y & tm) << VOXEL_TILE_SHIFT) | (x & tm);
+
+		/* No byte gather in SSE2/NEON, lanes are loaded one by one */
+		for (k = 0; k < VOXEL_LANES; k++)
+			h[k] = v->map[idx[k]].height;
+
+		hs = (v->cam.h - __builtin_convertvector(h, vfloat_t)) * s->invz + (float)v->cam.horiz;
+		ht = __builtin_convertvector(hs, vint_t);
+
+		memcpy(&hb, &v->bufBack[i], sizeof(hb));
+		mask = ht < hb;
+
+		for (k = 0; k < VOXEL_LANES; k++) {
+			if (mask[k])
+				voxel_drawLine(cols + (i + k - from) * v->colStep, v->rowStep, ht[k], hb[k], v->palette[v->map[idx[k]].color]);
+		}
+
+		hb = (ht & mask) | (hb & ~mask);
+		memcpy(&v->bufBack[i], &hb, sizeof(hb));
+
+		col += (float)VOXEL_LANES;
+	}
+
+	return i;
+}
+
+#endif
+
+
+static void voxel_drawView(voxel_t *v, uint32_t *cols, unsigned int from, unsigned int to)
 {
-	int hs = 0, x = 0, y = 0, i;
 	int scale_height = 120;
+	unsigned int i;
+	slice_t s;
 
 	float z = 1.0f;
 	float dz = 1.0f;
 	float cosa = cosf(v->cam.angle);
 	float sina = sinf(v->cam.angle);
 
-	for (i = 0; i < v->width; i++)
+	for (i = from; i < to; i++)
 		v->bufBack[i] = v->height;
 
 	for (z = 1.0, dz = 1.0; z < v->cam.dist;) {
 		float cosz = cosa * z, sinz = sina * z;
 
-		float ax = -cosz - sinz, ay = sinz - cosz;
 		float bx = cosz - sinz, by = -sinz - cosz;
 
-		float dx = (bx - ax) / v->width;
-		float dy = (by - ay) / v->width;
+		s.ax = -cosz - sinz, s.ay = sinz - cosz;
+		s.dx = (bx - s.ax) / v->width;
+		s.dy = (by - s.ay) / v->width;
 
-		ax += v->cam.x, ay += v->cam.y;
+		s.ax += v->cam.x, s.ay += v->cam.y;
 
-		float invz = 1.0f / z * scale_height;
+		s.invz = 1.0f / z * scale_height;
 
-		for (i = 0; i < v->width; i++) {
-			x = ((int)ax) & (1024 - 1);
-			y = ((int)ay) & (1024 - 1);
+		i = from;
+#ifdef VOXEL_SIMD
+		if (v->simd)
+			i = voxel_drawSpanSimd(v, &s, cols, from, to);
+#endif
+		voxel_drawSpan(v, &s, cols + (i - from) * v->colStep, i, to);
 
-			hs = (v->cam.h - v->mapHeight[x + y * 1024]) * invz + v->cam.horiz;
+		dz += 0.0005;
+		z += dz;
+	}
+}
 
-			voxel_drawLine(v->pixels, v->width, i, hs, v->bufBack[i], v->palette[v->mapColor[x + y * 1024]]);
+#endif
 
-			if (hs < v->bufBack[i])
-				v->bufBack[i] = hs;
 
-			ax += dx;
-			ay += dy;
-		}
+/* Per channel (pixel * (256 - alpha) + col * alpha) / 256, red and blue share one multiply */
+static inline uint32_t voxel_blend(uint32_t pixel, uint32_t col, unsigned int alpha)
+{
+	uint32_t rb = ((pixel & 0xff00ff) * (256 - alpha) + (col & 0xff00ff) * alpha) >> 8;
+	uint32_t g = ((pixel & 0x00ff00) * (256 - alpha) + (col & 0x00ff00) * alpha) >> 8;
 
-		dz += 0.0005;
-		z += dz;
+	return (rb & 0xff00ff) | (g & 0x00ff00);
+}
+
+
+/* Sky color blended over row r of the background */
+static inline uint32_t voxel_sky(unsigned int r, unsigned int *alpha)
+{
+	unsigned int j = 1080 / 2 - r;
+
+	*alpha = j < 255 ? j : 0xff;
+
+	return voxel_blend(0xffffffff, VOXEL_SKY, *alpha);
+}
+
+
+/* Transposes pixels [c, c + n) of row r from src, terrain fills each column from bufBack down */
+static void voxel_skyRow(voxel_t *v, const uint32_t *src, unsigned int r, unsigned int c, unsigned int n)
+{
+	uint32_t *dst = v->pixels + r * v->width + c, sky;
+	const int *back = v->bufBack + c;
+	unsigned int i;
+	unsigned int alpha;
+
+	if (r < 1080 / 2) {
+		sky = voxel_sky(r, &alpha);
+
+		for (i = 0; i < n; i++)
+			dst[i] = (int)r < back[i] ? sky : voxel_blend(src[i * v->height], VOXEL_SKY, alpha);
+	}
+	else {
+		for (i = 0; i < n; i++)
+			dst[i] = (int)r < back[i] ? 0xffffffff : src[i * v->height];
 	}
 }
 
 
-static void voxel_drawSky(voxel_t *v, int post)
+#ifdef VOXEL_SIMD
+
+typedef uint32_t vpix_t __attribute__((vector_size(4 * sizeof(uint32_t))));
+typedef int32_t vpixs_t __attribute__((vector_size(4 * sizeof(int32_t))));
+
+
+static inline vpix_t voxel_blendSimd(vpix_t pixel, uint32_t col, unsigned int alpha)
 {
-	int i, j, alpha;
-	uint32_t col, *pixels = v->pixels;
-	uint8_t r0, r1, g0, g1, b0, b1;
+	vpix_t rb = ((pixel & 0xff00ff) * (256 - alpha) + (col & 0xff00ff) * alpha) >> 8;
+	vpix_t g = ((pixel & 0x00ff00) * (256 - alpha) + (col & 0x00ff00) * alpha) >> 8;
 
-	if (post)
-		col = 0x6c9eff;
-	else
-		col = 0x009eff;
+	return (rb & 0xff00ff) | (g & 0x00ff00);
+}
 
-	for (j = 1080 / 2; j > 0; j--) {
-		alpha = j < 255 && post ? j : 0xff;
 
-		for (i = 0; i < v->width; i++) {
-			r0 = ((unsigned)*pixels >> 16) & 0xff;
-			g0 = ((unsigned)*pixels >> 8) & 0xff;
-			b0 = ((unsigned)*pixels) & 0xff;
+/* Same as voxel_skyRow() for a 4x4 block at column c, row r */
+static void voxel_skyBlock(voxel_t *v, const uint32_t *src, unsigned int r, unsigned int c)
+{
+	vpix_t c0, c1, c2, c3, t0, t1, t2, t3, row[4], mask, sky;
+	vpixs_t back;
+	unsigned int k;
+	unsigned int alpha;
+
+	memcpy(&c0, src, sizeof(c0));
+	memcpy(&c1, src + v->height, sizeof(c1));
+	memcpy(&c2, src + 2 * v->height, sizeof(c2));
+	memcpy(&c3, src + 3 * v->height, sizeof(c3));
+	memcpy(&back, v->bufBack + c, sizeof(back));
+
+	t0 = __builtin_shuffle(c0, c1, (vpix_t) { 0, 4, 1, 5 });
+	t1 = __builtin_shuffle(c0, c1, (vpix_t) { 2, 6, 3, 7 });
+	t2 = __builtin_shuffle(c2, c3, (vpix_t) { 0, 4, 1, 5 });
+	t3 = __builtin_shuffle(c2, c3, (vpix_t) { 2, 6, 3, 7 });
+
+	row[0] = __builtin_shuffle(t0, t2, (vpix_t) { 0, 1, 4, 5 });
+	row[1] = __builtin_shuffle(t0, t2, (vpix_t) { 2, 3, 6, 7 });
+	row[2] = __builtin_shuffle(t1, t3, (vpix_t) { 0, 1, 4, 5 });
+	row[3] = __builtin_shuffle(t1, t3, (vpix_t) { 2, 3, 6, 7 });
+
+	for (k = 0; k < 4; k++, r++) {
+		mask = (vpix_t)(back > (vpixs_t) {} + (int)r);
+
+		if (r < 1080 / 2) {
+			sky = (vpix_t) {} + voxel_sky(r, &alpha);
+			row[k] = (sky & mask) | (voxel_blendSimd(row[k], VOXEL_SKY, alpha) & ~mask);
+		}
+		else {
+			row[k] |= mask;
+		}
 
-			r1 = ((unsigned)col >> 16) & 0xff;
-			g1 = ((unsigned)col >> 8) & 0xff;
-			b1 = ((unsigned)col) & 0xff;
+		memcpy(v->pixels + r * v->width + c, &row[k], sizeof(row[k]));
+	}
+}
 
-			r0 = ((r0) + ((((r1) - (r0)) * (alpha)) >> 8));
-			g0 = ((g0) + ((((g1) - (g0)) * (alpha)) >> 8));
-			b0 = ((b0) + ((((b1) - (b0)) * (alpha)) >> 8));
+#endif
 
-			*pixels = (((unsigned)r0 << 16) & 0xff0000);
-			*pixels += (((unsigned)g0 << 8) & 0x00ff00);
-			*pixels += (((unsigned)b0 << 0) & 0x0000ff);
 
-			pixels++;
+/*
+ * Transposes columns [from, to) from cols to rows of pixels in VOXEL_BLOCK square
+ * blocks, blending the sky over the top 1080 / 2 rows on the way. Rows above
+ * bufBack are background, they are not cleared nor read.
+ */
+static void voxel_drawSky(voxel_t *v, const uint32_t *cols, unsigned int from, unsigned int to)
+{
+	unsigned int r0, c0, r, rn, cn;
+#ifdef VOXEL_SIMD
+	unsigned int c;
+#endif
+
+	for (r0 = 0; r0 < v->height; r0 += VOXEL_BLOCK) {
+		rn = v->height - r0 < VOXEL_BLOCK ? v->height - r0 : VOXEL_BLOCK;
+
+		for (c0 = from; c0 < to; c0 += VOXEL_BLOCK) {
+			cn = to - c0 < VOXEL_BLOCK ? to - c0 : VOXEL_BLOCK;
+
+#ifdef VOXEL_SIMD
+			if ((rn & 3) == 0 && (cn & 3) == 0) {
+				for (r = r0; r < r0 + rn; r += 4)
+					for (c = c0; c < c0 + cn; c += 4)
+						voxel_skyBlock(v, cols + (c - from) * v->height + r, r, c);
+				continue;
+			}
+#endif
+			for (r = r0; r < r0 + rn; r++)
+				voxel_skyRow(v, cols + (c0 - from) * v->height + r, r, c0, cn);
 		}
 	}
 }
 
 
-static void voxel_genLand(voxel_t *v)
+/* Blends the sky over columns [from, to) of pixels in place, fills the background above bufBack */
+static void voxel_drawSkyRows(voxel_t *v, unsigned int from, unsigned int to)
 {
-	unsigned int tmp;
-	int p, i, j, k, k2, p2;
-	int a, b, c, d;
+	uint32_t *dst, sky;
+	unsigned int r, i, alpha;
 
-	/* Start from a plasma clouds fractal */
-	v->mapHeight[0] = 128;
-	for (p = 1024; p > 1; p = p2) {
-		p2 = p >> 1;
-		k = p * 8 + 20;
-		k2 = k >> 1;
-		for (i = 0; i < 1024; i += p) {
-			for (j = 0; j < 1024; j += p) {
-				a = v->mapHeight[(i << 10) + j];
-				b = v->mapHeight[(((i + p) & 0x3ff) << 10) + j];
-				c = v->mapHeight[(i << 10) + ((j + p) & 0x3ff)];
-				d = v->mapHeight[(((i + p) & 0x3ff) << 10) + ((j + p) & 0x3ff)];
-
-				v->mapHeight[(i << 10) + ((j + p2) & 0x3ff)] =
-					clamp(((a + c) >> 1) + (rand() % k - k2));
-				v->mapHeight[(((i + p2) & 0x3ff) << 10) + ((j + p2) & 0x3ff)] =
-					clamp(((a + b + c + d) >> 2) + (rand() % k - k2));
-				v->mapHeight[(((i + p2) & 0x3ff) << 10) + j] =
-					clamp(((a + b) >> 1) + (rand() % k - k2));
+	for (r = 0; r < v->height; r++) {
+		dst = v->pixels + r * v->width;
+
+		if (r < 1080 / 2) {
+			sky = voxel_sky(r, &alpha);
+
+			for (i = from; i < to; i++)
+				dst[i] = (int)r < v->bufBack[i] ? sky : voxel_blend(dst[i], VOXEL_SKY, alpha);
+		}
+		else {
+			for (i = from; i < to; i++) {
+				if ((int)r < v->bufBack[i])
+					dst[i] = 0xffffffff;
 			}
 		}
 	}
+}
+
 
-	/* clamp unwanted noise level */
-	for (i = 0; i < 1024 * 1024; i += 1024) {
-		for (j = 0; j < 1024; j++) {
-			if (v->mapHeight[i + j] < 50)
-				v->mapHeight[i + j] = 50;
+/*
+ * Renders columns [from, to) of a frame in chunks, each drawn to the band's
+ * column-major scratch and transposed while it is still in cache. Without
+ * the scratch columns are drawn straight to pixels, a row apart.
+ */
+static void voxel_drawBand(voxel_t *v, unsigned int band, unsigned int from, unsigned int to)
+{
+	uint32_t *cols = v->columns + band * VOXEL_CHUNK * v->height;
+	unsigned long long t0 = 0, t1 = 0;
+	unsigned int end;
 
-			v->mapHeight[i + j] -= 50;
+	if (v->columns == NULL) {
+		if (v->timing)
+			t0 = voxel_now();
+
+		voxel_drawView(v, v->pixels + from, from, to);
+
+		if (v->timing)
+			t1 = voxel_now();
+
+		voxel_drawSkyRows(v, from, to);
+
+		if (v->timing) {
+			v->stages[band].view += t1 - t0;
+			v->stages[band].sky += voxel_now() - t1;
 		}
+		return;
 	}
 
-	/* Initialize color map */
-	for (i = 0; i < 1024 * 1024; i += 1024)
-		for (j = 0; j < 1024; j++)
-			v->mapColor[i + j] = v->mapHeight[i + j];
+	for (; from < to; from = end) {
+		end = to - from < VOXEL_CHUNK ? to : from + VOXEL_CHUNK;
+
+		if (v->timing)
+			t0 = voxel_now();
+
+		voxel_drawView(v, cols, from, end);
+
+		if (v->timing)
+			t1 = voxel_now();
 
-	/* clamp water level */
-	for (i = 0; i < 1024 * 1024; i += 1024) {
-		for (j = 0; j < 1024; j++) {
-			if (v->mapHeight[i + j] < 100)
-				v->mapHeight[i + j] = 100;
+		voxel_drawSky(v, cols, from, end);
 
-			v->mapHeight[i + j] -= 100;
+		if (v->timing) {
+			v->stages[band].view += t1 - t0;
+			v->stages[band].sky += voxel_now() - t1;
 		}
 	}
-	/* Smooth height map */
-	for (k = 0; k < 20; k++) {
-		for (i = 0; i < 1024 * 1024; i += 1024)
-			for (j = 0; j < 1024; j++) {
-				tmp = v->mapHeight[((i + 1024) & 0xffc00) + j];
-				tmp += v->mapHeight[i + ((j + 1) & 0x3ff)];
-				tmp += v->mapHeight[((i - 1024) & 0xffc00) + j];
-				tmp += v->mapHeight[i + ((j - 1) & 0x3ff)];
-				v->mapHeight[i + j] = tmp >> 2;
-			}
+}
+
+
+/* Counter based generator, a value depends on the seed and the cell only, not on the order cells are generated in */
+static inline uint32_t voxel_random(uint32_t seed, unsigned int x, unsigned int y)
+{
+	uint32_t h = seed ^ (x * 0x9e3779b1u) ^ (y * 0x85ebca77u);
+
+	h ^= h >> 16;
+	h *= 0x7feb352du;
+	h ^= h >> 15;
+	h *= 0x846ca68bu;
+	h ^= h >> 16;
+
+	return h;
+}
+
+
+/* One level of the plasma fractal, cells on odd multiples of p / 2 from corners on multiples of p */
+static void voxel_plasmaBand(voxel_t *v, unsigned int band, unsigned int from, unsigned int to)
+{
+	unsigned int p = v->gen.p, p2 = p >> 1, k = p * 8 + 20, k2 = k >> 1;
+	unsigned int i, j, i2, j2, ip, jp;
+	int a, b, c, d;
+
+	(void)band;
+
+	for (i = from * p; i < to * p; i += p) {
+		i2 = (i + p2) & 0x3ff;
+		ip = (i + p) & 0x3ff;
+		for (j = 0; j < 1024; j += p) {
+			j2 = (j + p2) & 0x3ff;
+			jp = (j + p) & 0x3ff;
+			a = v->mapHeight[(i << 10) + j];
+			b = v->mapHeight[(ip << 10) + j];
+			c = v->mapHeight[(i << 10) + jp];
+			d = v->mapHeight[(ip << 10) + jp];
+
+			v->mapHeight[(i << 10) + j2] =
+				clamp(((a + c) >> 1) + (int)(voxel_random(v->gen.seed, j2, i) % k) - (int)k2);
+			v->mapHeight[(i2 << 10) + j2] =
+				clamp(((a + b + c + d) >> 2) + (int)(voxel_random(v->gen.seed, j2, i2) % k) - (int)k2);
+			v->mapHeight[(i2 << 10) + j] =
+				clamp(((a + b) >> 1) + (int)(voxel_random(v->gen.seed, j, i2) % k) - (int)k2);
+		}
+	}
+}
+
+
+/* Clamps noise level, takes the color map from the heights and clamps water level in one pass */
+static void voxel_clampBand(voxel_t *v, unsigned int band, unsigned int from, unsigned int to)
+{
+	unsigned int i;
+	uint8_t h;
+
+	(void)band;
+
+	for (i = from << 10; i < to << 10; i++) {
+		h = v->mapHeight[i] < 50 ? 0 : v->mapHeight[i] - 50;
+		v->mapColor[i] = h;
+		v->mapHeight[i] = h < 100 ? 0 : h - 100;
 	}
+}
+
+
+/* Every cell of the row becomes the average of its four neighbours on the torus */
+static inline void voxel_smoothRow(uint8_t *dst, const uint8_t *up, const uint8_t *row, const uint8_t *down)
+{
+	unsigned int j;
+
+	dst[0] = (up[0] + down[0] + row[1023] + row[1]) >> 2;
+	for (j = 1; j < 1023; j++)
+		dst[j] = (up[j] + down[j] + row[j - 1] + row[j + 1]) >> 2;
+	dst[1023] = (up[1023] + down[1023] + row[1022] + row[0]) >> 2;
+}
+
 
-	/* Smooth color map */
-	for (k = 0; k < 1; k++) {
-		for (i = 0; i < 1024 * 1024; i += 1024)
-			for (j = 0; j < 1024; j++) {
-				tmp = v->mapColor[((i + 1024) & 0xffc00) + j];
-				tmp += v->mapColor[i + ((j + 1) & 0x3ff)];
-				tmp += v->mapColor[((i - 1024) & 0xffc00) + j];
-				tmp += v->mapColor[i + ((j - 1) & 0x3ff)];
-				v->mapColor[i + j] = tmp >> 2;
+/*
+ * Smooths rows [from, to) of gen.src into gen.dst with gen.passes passes in a single sweep.
+ * Row i of pass k needs rows i - 1..i + 1 of pass k - 1, so pass k trails pass k - 1 by one
+ * row and only the last three rows of every pass are kept, in the band's ring of rows.
+ * Neighbouring bands compute the halo of passes - 1 rows on both sides twice.
+ */
+static void voxel_smoothBand(voxel_t *v, unsigned int band, unsigned int from, unsigned int to)
+{
+	const uint8_t *src = v->gen.src, *rows[3];
+	uint8_t *ring = v->gen.ring + band * VOXEL_SMOOTH_RING, *dst;
+	int passes = v->gen.passes, k, r, i, halo;
+
+	if (from == to)
+		return;
+
+	for (r = (int)from - passes + 1; r < (int)to + passes; r++) {
+		for (k = 1; k <= passes; k++) {
+			i = r - k;
+			halo = passes - k;
+			if (i < (int)from - halo || i >= (int)to + halo)
+				continue;
+
+			if (k == 1) {
+				rows[0] = src + (((i + 1023) & 0x3ff) << 10);
+				rows[1] = src + ((i & 0x3ff) << 10);
+				rows[2] = src + (((i + 1) & 0x3ff) << 10);
+			}
+			else {
+				rows[0] = ring + ((k - 2) * 3 + (i + 3071) % 3) * 1024;
+				rows[1] = ring + ((k - 2) * 3 + (i + 3072) % 3) * 1024;
+				rows[2] = ring + ((k - 2) * 3 + (i + 3073) % 3) * 1024;
 			}
+
+			if (k == passes)
+				dst = v->gen.dst + (i << 10);
+			else
+				dst = ring + ((k - 1) * 3 + (i + 3072) % 3) * 1024;
+
+			voxel_smoothRow(dst, rows[0], rows[1], rows[2]);
+		}
 	}
 }
 
 
+/* Smooths a map with the given number of passes, the map is replaced with the smoothed copy */
+static void voxel_smooth(voxel_t *v, uint8_t **map, uint8_t **tmp, int passes)
+{
+	uint8_t *t;
+
+	v->gen.src = *map;
+	v->gen.dst = *tmp;
+	v->gen.passes = passes;
+	voxel_parallel(v, voxel_smoothBand, 1024);
+
+	t = *map;
+	*map = *tmp;
+	*tmp = t;
+}
+
+
+static int voxel_genLand(voxel_t *v)
+{
+	unsigned long long t0, t1, t2;
+	uint8_t *tmp;
+	unsigned int p;
+
+	/* Row-major maps are freed by voxel_packMap(), or by voxel_free() on failure */
+	v->mapShift = VOXEL_MAP_SHIFT;
+	v->mapHeight = malloc(1024 * 1024);
+	v->mapColor = malloc(1024 * 1024);
+	v->map = malloc(1024 * 1024 * sizeof(cell_t));
+	tmp = malloc(1024 * 1024);
+	v->gen.ring = malloc(v->pool.nbands * VOXEL_SMOOTH_RING);
+	if (v->mapHeight == NULL || v->mapColor == NULL || v->map == NULL || tmp == NULL || v->gen.ring == NULL) {
+		free(v->gen.ring);
+		free(tmp);
+		v->gen.ring = NULL;
+		return -1;
+	}
+
+	t0 = voxel_now();
+
+	/* Start from a plasma clouds fractal, levels depend on each other, rows of a level don't */
+	v->mapHeight[0] = 128;
+	for (p = 1024; p > 1; p >>= 1) {
+		v->gen.p = p;
+		voxel_parallel(v, voxel_plasmaBand, 1024 / p);
+	}
+
+	voxel_parallel(v, voxel_clampBand, 1024);
+	t1 = voxel_now();
+
+	voxel_smooth(v, &v->mapHeight, &tmp, VOXEL_SMOOTH_PASSES);
+	voxel_smooth(v, &v->mapColor, &tmp, 1);
+	t2 = voxel_now();
+
+	v->gen.plasma = t1 - t0;
+	v->gen.smooth = t2 - t1;
+
+	free(v->gen.ring);
+	free(tmp);
+	v->gen.ring = NULL;
+
+	return 0;
+}
+
+
+/* Interleaves generated heights and colors into the tiled map, the row-major maps are no longer needed */
+static void voxel_packMap(voxel_t *v)
+{
+	unsigned int x, y;
+	cell_t *cell;
+
+	for (y = 0; y < 1024; y++) {
+		for (x = 0; x < 1024; x++) {
+			cell = &v->map[voxel_cellIdx(v->mapShift, x, y)];
+			cell->height = v->mapHeight[(y << 10) + x];
+			cell->color = v->mapColor[(y << 10) + x];
+		}
+	}
+
+	free(v->mapColor);
+	free(v->mapHeight);
+	v->mapColor = NULL;
+	v->mapHeight = NULL;
+}
+
+
+/* Maps a terrain file written by voxel_saveMap(), falls back to reading it if the filesystem can't map files */
+static int voxel_loadMap(voxel_t *v, const char *path)
+{
+	voxel_maphdr_t hdr;
+	struct stat st;
+	size_t size;
+	void *data;
+	ssize_t len;
+	size_t done;
+	int fd;
+
+	if ((fd = open(path, O_RDONLY)) < 0)
+		return -1;
+
+	do {
+		if (fstat(fd, &st) < 0 || read(fd, &hdr, sizeof(hdr)) != sizeof(hdr))
+			break;
+
+		if (memcmp(hdr.magic, VOXEL_MAP_MAGIC, sizeof(hdr.magic)) != 0 || hdr.cellsz != sizeof(cell_t))
+			break;
+
+		/* Cells are stored in the renderer's order, a different tiling would need repacking */
+		if (hdr.tile != VOXEL_TILE_SHIFT || hdr.shift < VOXEL_TILE_SHIFT || hdr.shift > VOXEL_MAP_SHIFT_MAX)
+			break;
+
+		size = sizeof(hdr) + ((size_t)sizeof(cell_t) << (2 * hdr.shift));
+		if (st.st_size < 0 || (size_t)st.st_size < size)
+			break;
+
+		data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data != MAP_FAILED) {
+			v->mapFile = data;
+			v->mapFileSz = size;
+			v->map = (cell_t *)((uint8_t *)data + sizeof(hdr));
+		}
+		else {
+			if ((v->map = malloc(size - sizeof(hdr))) == NULL)
+				break;
+
+			for (done = 0; done < size - sizeof(hdr); done += len) {
+				if ((len = read(fd, (uint8_t *)v->map + done, size - sizeof(hdr) - done)) <= 0)
+					break;
+			}
+
+			if (done < size - sizeof(hdr)) {
+				free(v->map);
+				v->map = NULL;
+				break;
+			}
+		}
+
+		v->mapShift = hdr.shift;
+		close(fd);
+
+		return EOK;
+	} while (0);
+
+	close(fd);
+
+	return -1;
+}
+
+
+static int voxel_saveMap(voxel_t *v, const char *path)
+{
+	voxel_maphdr_t hdr = {
+		.magic = VOXEL_MAP_MAGIC,
+		.shift = v->mapShift,
+		.tile = VOXEL_TILE_SHIFT,
+		.cellsz = sizeof(cell_t),
+	};
+	size_t ncells = (size_t)1 << (2 * v->mapShift);
+	FILE *f;
+	int err = 0;
+
+	if ((f = fopen(path, "wb")) == NULL)
+		return -1;
+
+	if (fwrite(&hdr, sizeof(hdr), 1, f) != 1 || fwrite(v->map, sizeof(cell_t), ncells, f) != ncells)
+		err = -1;
+
+	if (fclose(f) < 0)
+		err = -1;
+
+	return err;
+}
+
+
 static void voxel_genPalette(voxel_t *v)
 {
 	unsigned int i, idx = 0;
@@ -312,53 +1229,460 @@ static void signalHandler(int signo)
 }
 
 
-static int voxel_demo(graph_t *g)
+static void voxel_frame(voxel_t *v)
+{
+#ifndef VOXEL_NOGRAPH
+	unsigned long long t;
+#endif
+
+	/* Returns after all bands are drawn, so the frame is complete before commit */
+	voxel_parallel(v, voxel_drawBand, v->width);
+
+	v->cam.x += 0.8f;
+	v->cam.y += 0.008f;
+	v->cam.angle += 0.008f;
+
+#ifndef VOXEL_NOGRAPH
+	if (v->graph != NULL) {
+		t = v->timing ? voxel_now() : 0;
+		/* FIXME: flip double buffer to screen, this shall be done in graph_commit() */
+		if (v->screen != NULL)
+			memcpy(v->screen, v->pixels, v->width * v->height * sizeof(uint32_t));
+		graph_commit(v->graph);
+		if (v->timing)
+			v->commit += voxel_now() - t;
+	}
+#endif
+}
+
+
+static const char *voxel_kernel(voxel_t *v)
+{
+#ifdef VOXEL_FIXED
+	return "fixed";
+#else
+	return v->simd ? "simd" : "scalar";
+#endif
+}
+
+
+/* Renders the same flight with 1 to N bands and prints frame rates */
+static void voxel_scaling(voxel_t *v, unsigned int frames)
+{
+	unsigned long long start, elapsed, base = 0;
+	unsigned int n, i, nthreads = v->pool.nworkers + 1;
+	camera_t cam = v->cam;
+
+	printf("voxeldemo: %ux%u, %s kernel, %u frames per run\n", v->width, v->height, voxel_kernel(v), frames);
+	printf("%8s %10s %10s %10s %8s\n", "threads", "time [ms]", "frame [us]", "fps", "speedup");
+
+	for (n = 1; n <= nthreads && flagQuit == 0; n++) {
+		voxel_setBands(v, n);
+		v->cam = cam;
+
+		start = voxel_now();
+		for (i = 0; i < frames && flagQuit == 0; i++)
+			voxel_frame(v);
+		elapsed = (voxel_now() - start) / 1000;
+
+		if (i == 0)
+			break;
+		if (elapsed == 0)
+			elapsed = 1;
+		if (n == 1)
+			base = elapsed;
+
+		printf("%8u %10llu %10llu %7llu.%02llu %5llu.%02llu\n", n, elapsed / 1000, elapsed / i,
+			i * 100000000ULL / elapsed / 100, i * 100000000ULL / elapsed % 100,
+			base * 100 / elapsed / 100, base * 100 / elapsed % 100);
+	}
+
+	voxel_setBands(v, nthreads);
+}
+
+
+/* Renders frames with all bands and prints average per frame time of each stage */
+static void voxel_bench(voxel_t *v, unsigned int frames)
+{
+	unsigned long long start, elapsed, view = 0, sky = 0;
+	unsigned int i, n;
+
+	v->timing = 1;
+	v->commit = 0;
+	memset(v->stages, 0, sizeof(v->stages));
+
+	start = voxel_now();
+	for (i = 0; i < frames && flagQuit == 0; i++)
+		voxel_frame(v);
+	elapsed = voxel_now() - start;
+
+	v->timing = 0;
+	if (i == 0)
+		return;
+
+	for (n = 0; n < v->pool.nbands; n++) {
+		view += v->stages[n].view;
+		sky += v->stages[n].sky;
+	}
+
+	printf("voxeldemo: %ux%u, %s kernel, %u threads, %u frames\n", v->width, v->height, voxel_kernel(v), v->pool.nbands, i);
+	printf("%8s %10s\n", "stage", "[us/frame]");
+	printf("%8s %10llu (sum over threads)\n", "view", view / i / 1000);
+	printf("%8s %10llu (sum over threads)\n", "sky", sky / i / 1000);
+	printf("%8s %10llu\n", "commit", v->commit / i / 1000);
+	printf("%8s %10llu (%llu.%02llu fps)\n", "frame", elapsed / i / 1000,
+		i * 100000000000ULL / elapsed / 100, i * 100000000000ULL / elapsed % 100);
+}
+
+
+/* Frames are saved as binary PPM, which common image tools can view and diff */
+static int voxel_saveFrame(voxel_t *v, const char *path)
+{
+	uint8_t *row;
+	unsigned int x, y;
+	uint32_t pixel;
+	FILE *f;
+	int err = 0;
+
+	if ((row = malloc(v->width * 3)) == NULL)
+		return -1;
+
+	if ((f = fopen(path, "wb")) == NULL) {
+		free(row);
+		return -1;
+	}
+
+	if (fprintf(f, "P6\n%u %u\n255\n", v->width, v->height) < 0)
+		err = -1;
+
+	for (y = 0; y < v->height && err == 0; y++) {
+		for (x = 0; x < v->width; x++) {
+			pixel = v->pixels[y * v->width + x];
+			row[3 * x] = pixel >> 16;
+			row[3 * x + 1] = pixel >> 8;
+			row[3 * x + 2] = pixel;
+		}
+
+		if (fwrite(row, 3, v->width, f) != v->width)
+			err = -1;
+	}
+
+	free(row);
+
+	if (fclose(f) < 0)
+		err = -1;
+
+	return err;
+}
+
+
+/* Compares the last frame with a saved one, returns 1 if too many pixels differ */
+static int voxel_checkFrame(voxel_t *v, const char *path)
+{
+	size_t n = v->width * v->height, i, ndiff = 0;
+	unsigned int k, d, delta, dmax = 0, w, h, maxval;
+	uint8_t *golden;
+	FILE *f;
+
+	if ((golden = malloc(n * 3)) == NULL)
+		return -1;
+
+	if ((f = fopen(path, "rb")) == NULL) {
+		free(golden);
+		return -1;
+	}
+
+	/* Single whitespace after maxval, then raw RGB triplets */
+	if (fscanf(f, "P6 %u %u %u", &w, &h, &maxval) != 3 || w != v->width || h != v->height || maxval != 255 ||
+			fgetc(f) == EOF || fread(golden, 3, n, f) != n) {
+		fprintf(stderr, "voxeldemo: %s is not a %ux%u frame\n", path, v->width, v->height);
+		fclose(f);
+		free(golden);
+		return -1;
+	}
+	fclose(f);
+
+	for (i = 0; i < n; i++) {
+		for (k = 0, delta = 0; k < 3; k++) {
+			d = abs((int)((v->pixels[i] >> (16 - 8 * k)) & 0xff) - (int)golden[3 * i + k]);
+			if (d > delta)
+				delta = d;
+		}
+
+		if (delta > VOXEL_GOLDEN_DELTA)
+			ndiff++;
+		if (delta > dmax)
+			dmax = delta;
+	}
+	free(golden);
+
+	printf("voxeldemo: %zu of %zu pixels differ from %s (%zu.%zu%%), max delta %u\n",
+		ndiff, n, path, ndiff * 100 / n, ndiff * 1000 / n % 10, dmax);
+
+	return ndiff * 1000 > n * VOXEL_GOLDEN_LIMIT ? 1 : 0;
+}
+
+
+static int voxel_demo(graph_t *g, const voxel_opts_t *opts)
 {
 	voxel_t v = {
 		.cam = { .h = 300, .horiz = 200, .dist = 300 },
+		.simd = opts->simd,
+		.graph = opts->bench > 0 ? NULL : g,
+		.gen = { .seed = VOXEL_SEED },
 	};
+	unsigned int nthreads = opts->nthreads;
+	unsigned long long t;
+	int ret = 0;
+
+	/* Failures are reported here, callers only pass the error on. There is no
+	 * scanout offscreen, so frames are always drawn straight to memory there. */
+	if (voxel_init(&v, g, nthreads, opts->direct || v.graph == NULL, opts->transpose) < 0) {
+		fprintf(stderr, "voxeldemo: out of memory\n");
+		return -1;
+	}
 
-	if (voxel_init(&v, g) < 0)
+	if (voxel_poolInit(&v, nthreads) < 0) {
+		fprintf(stderr, "voxeldemo: failed to start worker threads\n");
+		voxel_free(&v);
 		return -1;
+	}
+
+	if (v.pool.nworkers + 1 < nthreads)
+		fprintf(stderr, "voxeldemo: started %u of %u threads\n", v.pool.nworkers + 1, nthreads);
 
 	signal(SIGINT, signalHandler);
 	signal(SIGQUIT, signalHandler);
 	signal(SIGTERM, signalHandler);
 
-	voxel_genLand(&v);
-	voxel_genPalette(&v);
+	t = voxel_now();
+	if (opts->load != NULL) {
+		if (voxel_loadMap(&v, opts->load) < 0) {
+			fprintf(stderr, "voxeldemo: failed to load terrain from %s\n", opts->load);
+			voxel_poolDone(&v);
+			voxel_free(&v);
+			return -1;
+		}
 
-	for (flagQuit = 0; flagQuit == 0;) {
-		memset(v.pixels, 0xff, g->width * g->height * g->depth);
+		t = voxel_now() - t;
+		if (opts->frames > 0 || opts->bench > 0)
+			printf("voxeldemo: terrain %ux%u %s %s in %llu us\n", 1u << v.mapShift, 1u << v.mapShift,
+				v.mapFile != NULL ? "mapped from" : "read from", opts->load, t / 1000);
+	}
+	else {
+		if (voxel_genLand(&v) < 0) {
+			fprintf(stderr, "voxeldemo: out of memory generating terrain\n");
+			voxel_poolDone(&v);
+			voxel_free(&v);
+			return -1;
+		}
 
-		voxel_drawView(&v);
-		voxel_drawSky(&v, 1);
+		v.gen.pack = voxel_now();
+		voxel_packMap(&v);
+		v.gen.pack = voxel_now() - v.gen.pack;
 
-		v.cam.x += 0.8f;
-		v.cam.y += 0.008f;
-		v.cam.angle += 0.008f;
+		if (opts->frames > 0 || opts->bench > 0)
+			printf("voxeldemo: terrain in %llu us (plasma %llu, smooth %llu, pack %llu), %u threads\n",
+				(v.gen.plasma + v.gen.smooth + v.gen.pack) / 1000, v.gen.plasma / 1000, v.gen.smooth / 1000,
+				v.gen.pack / 1000, v.pool.nbands);
+	}
+	voxel_genPalette(&v);
 
-		/* FIXME: flip double buffer to screen, this shall be done in graph_commit() */
-		memcpy(g->data, v.pixels, g->width * g->height * g->depth);
+	if (opts->store != NULL && voxel_saveMap(&v, opts->store) < 0) {
+		fprintf(stderr, "voxeldemo: failed to save terrain to %s\n", opts->store);
+		voxel_poolDone(&v);
+		voxel_free(&v);
+		return -1;
+	}
 
-		graph_commit(g);
+	flagQuit = 0;
+	if (opts->frames > 0)
+		voxel_scaling(&v, opts->frames);
+	else if (opts->bench > 0)
+		voxel_bench(&v, opts->bench);
+	else
+		while (flagQuit == 0)
+			voxel_frame(&v);
+
+	if (opts->save != NULL && voxel_saveFrame(&v, opts->save) < 0) {
+		fprintf(stderr, "voxeldemo: failed to save frame to %s\n", opts->save);
+		ret = -1;
 	}
 
+	if (opts->check != NULL && ret == 0 && (ret = voxel_checkFrame(&v, opts->check)) < 0)
+		fprintf(stderr, "voxeldemo: failed to check frame against %s\n", opts->check);
+
 	signal(SIGTERM, SIG_DFL);
 	signal(SIGQUIT, SIG_DFL);
 	signal(SIGINT, SIG_DFL);
 
+	voxel_poolDone(&v);
 	voxel_free(&v);
 
-	return 0;
+	return ret;
+}
+
+
+static void usage(const char *progname)
+{
+	printf("Usage: %s [options]\n", progname);
+	printf("Options:\n");
+	printf("\t-t <threads>  render with threads column bands (1-%u, default 1)\n", VOXEL_THREADS_MAX);
+	printf("\t-S <frames>   print frame rates for 1 to threads bands and exit\n");
+#ifdef VOXEL_SIMD
+	printf("\t-k <kernel>   column kernel: simd or scalar (default simd)\n");
+#else
+	printf("\t-k <kernel>   column kernel: scalar, simd is not supported on this target\n");
+#endif
+	printf("\t-b <frames>   render frames to memory without a graphics adapter, print stage times\n");
+	printf("\t-r <w>x<h>    resolution of -b rendering (default 800x600)\n");
+	printf("\t-G <file>     save the last frame of the -S or -b run as a golden PPM image\n");
+	printf("\t-g <file>     compare the last frame of the -S or -b run with a golden PPM image\n");
+	printf("\t-m <file>     map terrain from a file made with -M instead of generating it,\n");
+	printf("\t              the file is not installed by the build, copy it to the target by hand\n");
+	printf("\t-M <file>     save the terrain to a file, with -b 1 to only create the file\n");
+	printf("\t-D            draw straight to the framebuffer, tears unless the adapter flips buffers\n");
+	printf("\t-T            draw columns to a scratch and transpose it, for targets with slow strided writes\n");
+	printf("\t-h            print this help message\n");
 }
 
 
-int main(void)
+/* Renders to a framebuffer in memory, there is nothing to commit */
+static int voxel_offscreen(const voxel_opts_t *opts)
 {
+	graph_t g = {
+		.width = opts->width,
+		.height = opts->height,
+		.depth = 4,
+	};
 	int ret;
+
+	if ((g.data = malloc(g.width * g.height * g.depth)) == NULL) {
+		fprintf(stderr, "voxeldemo: out of memory\n");
+		return -ENOMEM;
+	}
+
+	ret = voxel_demo(&g, opts);
+
+	free(g.data);
+
+	return ret;
+}
+
+
+int main(int argc, char **argv)
+{
+	int c;
+	voxel_opts_t opts = { .nthreads = 1, .width = 800, .height = 600 };
+	char *end;
+#ifndef VOXEL_NOGRAPH
 	graph_t g;
+	int ret;
+#endif
+
+#ifdef VOXEL_SIMD
+	opts.simd = 1;
+#endif
+
+	while ((c = getopt(argc, argv, "t:S:k:b:r:G:g:m:M:DTh")) != -1) {
+		switch (c) {
+			case 't':
+				opts.nthreads = strtoul(optarg, NULL, 0);
+				if (opts.nthreads < 1 || opts.nthreads > VOXEL_THREADS_MAX) {
+					fprintf(stderr, "voxeldemo: invalid number of threads\n");
+					return EXIT_FAILURE;
+				}
+				break;
+
+			case 'S':
+				opts.frames = strtoul(optarg, NULL, 0);
+				if (opts.frames == 0) {
+					fprintf(stderr, "voxeldemo: invalid number of frames\n");
+					return EXIT_FAILURE;
+				}
+				break;
+
+			case 'k':
+				if (strcmp(optarg, "scalar") == 0)
+					opts.simd = 0;
+#ifdef VOXEL_SIMD
+				else if (strcmp(optarg, "simd") == 0)
+					opts.simd = 1;
+#endif
+				else {
+					fprintf(stderr, "voxeldemo: invalid kernel %s\n", optarg);
+					return EXIT_FAILURE;
+				}
+				break;
+
+			case 'b':
+				opts.bench = strtoul(optarg, NULL, 0);
+				if (opts.bench == 0) {
+					fprintf(stderr, "voxeldemo: invalid number of frames\n");
+					return EXIT_FAILURE;
+				}
+				break;
+
+			case 'r':
+				opts.width = strtoul(optarg, &end, 0);
+				opts.height = *end == 'x' ? strtoul(end + 1, NULL, 0) : 0;
+				if (opts.width < 1 || opts.width > 8192 || opts.height < 1 || opts.height > 8192) {
+					fprintf(stderr, "voxeldemo: invalid resolution %s\n", optarg);
+					return EXIT_FAILURE;
+				}
+				break;
+
+			case 'G':
+				opts.save = optarg;
+				break;
+
+			case 'g':
+				opts.check = optarg;
+				break;
+
+			case 'm':
+				opts.load = optarg;
+				break;
+
+			case 'M':
+				opts.store = optarg;
+				break;
+
+			case 'D':
+				opts.direct = 1;
+				break;
+
+			case 'T':
+				opts.transpose = 1;
+				break;
+
+			case 'h':
+				usage(argv[0]);
+				return EXIT_SUCCESS;
+
+			default:
+				usage(argv[0]);
+				return EXIT_FAILURE;
+		}
+	}
+
+	if ((opts.save != NULL || opts.check != NULL) && opts.frames == 0 && opts.bench == 0) {
+		fprintf(stderr, "voxeldemo: golden images require -S or -b\n");
+		return EXIT_FAILURE;
+	}
 
+	if (opts.frames > 0 && opts.bench > 0) {
+		fprintf(stderr, "voxeldemo: -S and -b are exclusive\n");
+		return EXIT_FAILURE;
+	}
+
+	if (opts.bench > 0)
+		return voxel_offscreen(&opts) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+
+#ifdef VOXEL_NOGRAPH
+	fprintf(stderr, "voxeldemo: built without graphics, use -b\n");
+	return EXIT_FAILURE;
+#else
 	if ((ret = graph_init()) < 0) {
 		fprintf(stderr, "failed to initialize library\n");
 		return ret;
@@ -381,14 +1705,18 @@ int main(void)
 			break;
 		}
 
-		if ((ret = voxel_demo(&g)) < 0) {
-			fprintf(stderr, "Something's gone teribly wrong\n");
+		if (g.width < 800 || g.height < 600) {
+			fprintf(stderr, "Demo requires at least 800x600 video resolution\n");
+			ret = -1;
 			break;
 		}
+
+		ret = voxel_demo(&g, &opts);
 	} while (0);
 
 	graph_close(&g);
 	graph_done();
 
 	return ret;
+#endif
 }